@@ -1,31 +1,70 @@
 #include "blp.h"
 #include "blp_internal.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
 #include <memory.h>
 #include <squish.h>
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
 // Forward declaration of "internal" functions
-tBGRAPixel* blp1_convert_jpeg(uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size);
-tBGRAPixel* blp1_convert_paletted_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp1_convert_paletted_no_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp1_convert_paletted_separated_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_no_alpha(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha1(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha4(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_paletted_alpha8(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_raw_bgra(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height);
-tBGRAPixel* blp2_convert_dxt(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height, int flags);
+void blp_store_pixels(const tBGRAPixel* pSrc, unsigned int width, unsigned int height, const tBLPTarget& target);
+bool blp_convert_target(const char* buffer, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, const tBLPTarget& target);
+bool blp_decode_into_target(const uint8_t* pSrc, uint32_t size, tInternalBLPInfos* pBLPInfos, unsigned int width,
+                            unsigned int height, const tBLPTarget& target);
 
 
 tBLPInfos blp_process_buffer(const char* buffer)
+{
+  return (tBLPInfos) blp_process_header(buffer, SIZE_MAX, false);
+}
+
+
+tBLPInfos blp_process_buffer(const char* buffer, size_t size)
+{
+  tInternalBLPInfos* pBLPInfos = blp_process_header(buffer, size, false);
+  if (!pBLPInfos)
+    return nullptr;
+
+  // Check that all the mip levels are in the buffer once and for all, so they can then be decoded
+  // without any further check
+  unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
+  for (unsigned int mipLevel = 0; mipLevel < nbMipLevels; ++mipLevel)
+  {
+    uint32_t offset;
+    uint32_t length;
+
+    if (pBLPInfos->version == 2)
+    {
+      offset = pBLPInfos->blp2.offsets[mipLevel];
+      length = pBLPInfos->blp2.lengths[mipLevel];
+    }
+    else
+    {
+      offset = pBLPInfos->blp1.header.offsets[mipLevel];
+      length = pBLPInfos->blp1.header.lengths[mipLevel];
+    }
+
+    size_t needed = blp_mip_level_size(pBLPInfos, blp_width(pBLPInfos, mipLevel), blp_height(pBLPInfos, mipLevel));
+
+    if ((length < needed) || (offset > size) || (length > size - offset))
+    {
+      blp_release(pBLPInfos);
+      return nullptr;
+    }
+  }
+
+  return (tBLPInfos) pBLPInfos;
+}
+
+
+tInternalBLPInfos* blp_process_header(const char* buffer, size_t size, bool bHeaderOnly)
 {
   unsigned int buffer_position;
 
+  if (size < 4)
+    return nullptr;
+
   auto* pBLPInfos = new tInternalBLPInfos();
   char magic[4];
 
@@ -34,25 +73,37 @@ tBLPInfos blp_process_buffer(const char* buffer)
 
   if (strncmp(magic, "BLP2", 4) == 0)
   {
+    if (size < sizeof(tBLP2Header))
+    {
+      delete pBLPInfos;
+      return nullptr;
+    }
+
     pBLPInfos->version = 2;
 
     buffer_position = 0;
     memcpy(&pBLPInfos->blp2, &buffer[buffer_position], sizeof(tBLP2Header));
 
     pBLPInfos->blp2.nbMipLevels = 0;
-    while ((pBLPInfos->blp2.offsets[pBLPInfos->blp2.nbMipLevels] != 0) && (pBLPInfos->blp2.nbMipLevels < 16))
+    while ((pBLPInfos->blp2.nbMipLevels < 16) && (pBLPInfos->blp2.offsets[pBLPInfos->blp2.nbMipLevels] != 0))
       ++pBLPInfos->blp2.nbMipLevels;
   }
   else if (strncmp(magic, "BLP1", 4) == 0)
   {
+    if (size < sizeof(tBLP1Header) + sizeof(uint32_t))
+    {
+      delete pBLPInfos;
+      return nullptr;
+    }
+
     pBLPInfos->version = 1;
 
     buffer_position = 0;
-    memcpy(&pBLPInfos->blp1.header, &buffer[buffer_position], sizeof(tBLP2Header));
-    buffer_position += sizeof(tBLP2Header);
+    memcpy(&pBLPInfos->blp1.header, &buffer[buffer_position], sizeof(tBLP1Header));
+    buffer_position += sizeof(tBLP1Header);
 
     pBLPInfos->blp1.infos.nbMipLevels = 0;
-    while ((pBLPInfos->blp1.header.offsets[pBLPInfos->blp1.infos.nbMipLevels] != 0) && (pBLPInfos->blp1.infos.nbMipLevels < 16))
+    while ((pBLPInfos->blp1.infos.nbMipLevels < 16) && (pBLPInfos->blp1.header.offsets[pBLPInfos->blp1.infos.nbMipLevels] != 0))
       ++pBLPInfos->blp1.infos.nbMipLevels;
 
     if (pBLPInfos->blp1.header.type == 0)
@@ -60,7 +111,19 @@ tBLPInfos blp_process_buffer(const char* buffer)
       memcpy(&pBLPInfos->blp1.infos.jpeg.headerSize, &buffer[buffer_position], sizeof(uint32_t));
       buffer_position += sizeof(uint32_t);
 
-      if (pBLPInfos->blp1.infos.jpeg.headerSize > 0)
+      if (bHeaderOnly)
+      {
+        // Only needed to decode the mip levels
+        pBLPInfos->blp1.infos.jpeg.headerSize = 0;
+        pBLPInfos->blp1.infos.jpeg.header = nullptr;
+        pBLPInfos->blp1.infos.jpeg.pTables = nullptr;
+      }
+      else if (pBLPInfos->blp1.infos.jpeg.headerSize > size - buffer_position)
+      {
+        delete pBLPInfos;
+        return nullptr;
+      }
+      else if (pBLPInfos->blp1.infos.jpeg.headerSize > 0)
       {
         pBLPInfos->blp1.infos.jpeg.header = new uint8_t[pBLPInfos->blp1.infos.jpeg.headerSize];
         memcpy(pBLPInfos->blp1.infos.jpeg.header, &buffer[buffer_position], pBLPInfos->blp1.infos.jpeg.headerSize);
@@ -69,6 +132,22 @@ tBLPInfos blp_process_buffer(const char* buffer)
       {
         pBLPInfos->blp1.infos.jpeg.header = nullptr;
       }
+
+      // The tables of the shared header are parsed once for all the mip levels (nullptr if the
+      // header is invalid, the mip levels then can't be decoded)
+      if (!bHeaderOnly)
+        pBLPInfos->blp1.infos.jpeg.pTables = blp_jpeg_parse_header(pBLPInfos->blp1.infos.jpeg.header,
+                                                                   pBLPInfos->blp1.infos.jpeg.headerSize);
+    }
+    else if (bHeaderOnly)
+    {
+      // Only needed to decode the mip levels
+      memset(&pBLPInfos->blp1.infos.palette, 0, sizeof(pBLPInfos->blp1.infos.palette));
+    }
+    else if (sizeof(pBLPInfos->blp1.infos.palette) > size - buffer_position)
+    {
+      delete pBLPInfos;
+      return nullptr;
     }
     else
     {
@@ -81,7 +160,14 @@ tBLPInfos blp_process_buffer(const char* buffer)
     return nullptr;
   }
 
-  return (tBLPInfos) pBLPInfos;
+  // Files without any mip level or with an empty one can't be decoded
+  if ((blp_nb_mip_levels(pBLPInfos) == 0) || (blp_width(pBLPInfos) == 0) || (blp_height(pBLPInfos) == 0))
+  {
+    blp_release(pBLPInfos);
+    return nullptr;
+  }
+
+  return pBLPInfos;
 }
 
 void blp_release(tBLPInfos blpInfos)
@@ -89,7 +175,10 @@ void blp_release(tBLPInfos blpInfos)
     tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
 
     if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.type == 0))
+    {
         delete[] pBLPInfos->blp1.infos.jpeg.header;
+        blp_jpeg_release(pBLPInfos->blp1.infos.jpeg.pTables);
+    }
 
     delete pBLPInfos;
 }
@@ -143,7 +232,7 @@ unsigned int blp_width(tBLPInfos blpInfos, unsigned int mipLevel)
         if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
             mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
 
-        return (pBLPInfos->blp2.width >> mipLevel);
+        return std::max(pBLPInfos->blp2.width >> mipLevel, 1u);
     }
     else
     {
@@ -151,7 +240,7 @@ unsigned int blp_width(tBLPInfos blpInfos, unsigned int mipLevel)
         if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
             mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
 
-        return (pBLPInfos->blp1.header.width >> mipLevel);
+        return std::max(pBLPInfos->blp1.header.width >> mipLevel, 1u);
     }
 }
 
@@ -166,7 +255,7 @@ unsigned int blp_height(tBLPInfos blpInfos, unsigned int mipLevel)
         if (mipLevel >= pBLPInfos->blp2.nbMipLevels)
             mipLevel = pBLPInfos->blp2.nbMipLevels - 1;
 
-        return (pBLPInfos->blp2.height >> mipLevel);
+        return std::max(pBLPInfos->blp2.height >> mipLevel, 1u);
     }
     else
     {
@@ -174,7 +263,7 @@ unsigned int blp_height(tBLPInfos blpInfos, unsigned int mipLevel)
         if (mipLevel >= pBLPInfos->blp1.infos.nbMipLevels)
             mipLevel = pBLPInfos->blp1.infos.nbMipLevels - 1;
 
-        return (pBLPInfos->blp1.header.height >> mipLevel);
+        return std::max(pBLPInfos->blp1.header.height >> mipLevel, 1u);
     }
 }
 
@@ -190,6 +279,37 @@ unsigned int blp_nb_mip_levels(tBLPInfos blpInfos)
 }
 
 
+// Minimum number of bytes of a mip level of the given dimensions (0 if unknown)
+size_t blp_mip_level_size(tInternalBLPInfos* pBLPInfos, unsigned int width, unsigned int height)
+{
+    size_t nbPixels = size_t(width) * height;
+    size_t nbBlocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+
+    switch (blp_format(pBLPInfos))
+    {
+        case BLP_FORMAT_PALETTED_NO_ALPHA:  return nbPixels;
+        case BLP_FORMAT_PALETTED_ALPHA_1:   return nbPixels + (nbPixels + 7) / 8;
+        case BLP_FORMAT_PALETTED_ALPHA_4:   return nbPixels + (nbPixels + 1) / 2;
+
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.alphaEncoding == 5))
+                return nbPixels;
+            return nbPixels * 2;
+
+        case BLP_FORMAT_RAW_BGRA:           return nbPixels * 4;
+
+        case BLP_FORMAT_DXT1_NO_ALPHA:
+        case BLP_FORMAT_DXT1_ALPHA_1:       return nbBlocks * 8;
+
+        case BLP_FORMAT_DXT3_ALPHA_4:
+        case BLP_FORMAT_DXT3_ALPHA_8:
+        case BLP_FORMAT_DXT5_ALPHA_8:       return nbBlocks * 16;
+
+        default:                            return 0;
+    }
+}
+
+
 tBGRAPixel *blp_convert_buffer(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel)
 {
   auto* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
@@ -210,7 +330,6 @@ tBGRAPixel *blp_convert_buffer(const char* buffer, tBLPInfos blpInfos, unsigned
   unsigned int width  = blp_width(pBLPInfos, mipLevel);
   unsigned int height = blp_height(pBLPInfos, mipLevel);
   tBGRAPixel* pDst    = 0;
-  uint8_t* pSrc       = 0;
   uint32_t offset;
   uint32_t size;
 
@@ -225,139 +344,93 @@ tBGRAPixel *blp_convert_buffer(const char* buffer, tBLPInfos blpInfos, unsigned
     size   = pBLPInfos->blp1.header.lengths[mipLevel];
   }
 
-  pSrc = new uint8_t[size];
-  memcpy(pSrc, &buffer[offset], size);
+  // The decoders read the mip level in place
+  const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(buffer) + offset;
 
-  switch (blp_format(pBLPInfos))
-  {
-  case BLP_FORMAT_JPEG:
-    // if (pBLPInfos->version == 2)
-    //     pDst = blp2_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp2, width, height);
-    // else
-    pDst = blp1_convert_jpeg(pSrc, &pBLPInfos->blp1.infos, size);
-    break;
-
-  case BLP_FORMAT_PALETTED_NO_ALPHA:
-    if (pBLPInfos->version == 2)
-      pDst = blp2_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp2, width, height);
-    else
-      pDst = blp1_convert_paletted_no_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-    break;
-
-  case BLP_FORMAT_PALETTED_ALPHA_1:  pDst = blp2_convert_paletted_alpha1(pSrc, &pBLPInfos->blp2, width, height); break;
-
-  case BLP_FORMAT_PALETTED_ALPHA_4:  pDst = blp2_convert_paletted_alpha4(pSrc, &pBLPInfos->blp2, width, height); break;
-
-  case BLP_FORMAT_PALETTED_ALPHA_8:
-    if (pBLPInfos->version == 2)
-    {
-      pDst = blp2_convert_paletted_alpha8(pSrc, &pBLPInfos->blp2, width, height);
-    }
-    else
-    {
-      if (pBLPInfos->blp1.header.alphaEncoding == 5)
-        pDst = blp1_convert_paletted_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-      else
-        pDst = blp1_convert_paletted_separated_alpha(pSrc, &pBLPInfos->blp1.infos, width, height);
-    }
-    break;
+  // The only copy of the raw BGRA pixels, since a new buffer is returned
+  pDst = new tBGRAPixel[width * height];
 
-  case BLP_FORMAT_RAW_BGRA: pDst = blp2_convert_raw_bgra(pSrc, &pBLPInfos->blp2, width, height); break;
+  tBLPTarget target;
+  target.pData  = reinterpret_cast<uint8_t*>(pDst);
+  target.pitch  = width * sizeof(tBGRAPixel);
+  target.format = BLP_PIXEL_FORMAT_BGRA8;
 
-  case BLP_FORMAT_DXT1_NO_ALPHA:
-  case BLP_FORMAT_DXT1_ALPHA_1:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt1); break;
-  case BLP_FORMAT_DXT3_ALPHA_4:
-  case BLP_FORMAT_DXT3_ALPHA_8:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt3); break;
-  case BLP_FORMAT_DXT5_ALPHA_8:      pDst = blp2_convert_dxt(pSrc, &pBLPInfos->blp2, width, height, squish::kDxt5); break;
-  default:                           break;
+  if (!blp_decode_into_target(pSrc, size, pBLPInfos, width, height, target))
+  {
+    delete[] pDst;
+    pDst = 0;
   }
 
-  delete[] pSrc;
-
   return pDst;
 }
 
-std::string blp_as_string(tBLPFormat format)
+uint8_t* blp_convert_buffer_as(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                               tBLPPixelFormat pixelFormat, tBLPRowOrder rowOrder)
 {
-    switch (format)
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
+
+    unsigned int width = blp_width(pBLPInfos, mipLevel);
+
+    uint8_t* pBuffer = new uint8_t[blp_required_size(pBLPInfos, mipLevel, pixelFormat)];
+
+    if (!blp_convert_into(buffer, pBLPInfos, mipLevel, pBuffer, width * blp_bytes_per_pixel(pixelFormat), pixelFormat,
+                          rowOrder))
     {
-        case BLP_FORMAT_JPEG:              return "JPEG";
-        case BLP_FORMAT_PALETTED_NO_ALPHA: return "Uncompressed paletted image, no alpha";
-        case BLP_FORMAT_PALETTED_ALPHA_1:  return "Uncompressed paletted image, 1-bit alpha";
-        case BLP_FORMAT_PALETTED_ALPHA_4:  return "Uncompressed paletted image, 4-bit alpha";
-        case BLP_FORMAT_PALETTED_ALPHA_8:  return "Uncompressed paletted image, 8-bit alpha";
-        case BLP_FORMAT_RAW_BGRA:          return "Uncompressed raw 32-bit BGRA";
-        case BLP_FORMAT_DXT1_NO_ALPHA:     return "DXT1, no alpha";
-        case BLP_FORMAT_DXT1_ALPHA_1:      return "DXT1, 1-bit alpha";
-        case BLP_FORMAT_DXT3_ALPHA_4:      return "DXT3, 4-bit alpha";
-        case BLP_FORMAT_DXT3_ALPHA_8:      return "DXT3, 8-bit alpha";
-        case BLP_FORMAT_DXT5_ALPHA_8:      return "DXT5, 8-bit alpha";
-        default:                           return "Unknown";
+        delete[] pBuffer;
+        return nullptr;
     }
+
+    return pBuffer;
 }
 
 
-tBGRAPixel* blp1_convert_jpeg(uint8_t* pSrc, tBLP1Infos* pInfos, uint32_t size)
+size_t blp_required_size(tBLPInfos blpInfos, unsigned int mipLevel, tBLPPixelFormat pixelFormat)
 {
-    auto* pSrcBuffer = new uint8_t[pInfos->jpeg.headerSize + size];
-
-    memcpy(pSrcBuffer, pInfos->jpeg.header, pInfos->jpeg.headerSize);
-    memcpy(pSrcBuffer + pInfos->jpeg.headerSize, pSrc, size);
-
-    // Load the JPEG image data from the buffer
-    int width, height, channels;
-    stbi_uc* pImageData = stbi_load_from_memory(pSrcBuffer, pInfos->jpeg.headerSize + size, &width, &height, &channels, 3);
+    return size_t(blp_width(blpInfos, mipLevel)) * blp_height(blpInfos, mipLevel) * blp_bytes_per_pixel(pixelFormat);
+}
 
-    delete[] pSrcBuffer; // Free the buffer used to hold the JPEG data and header
 
-    if (pImageData == nullptr) {
-      // Handle error
-      return nullptr;
-    }
-
-    // Allocate memory for the output BGRAPixel buffer
-    auto* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+bool blp_convert_into(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                      void* dst, size_t dstPitch, tBLPPixelFormat pixelFormat, tBLPRowOrder rowOrder)
+{
+    tBLPTarget target;
+    target.pData  = static_cast<uint8_t*>(dst);
+    target.pitch  = ptrdiff_t(dstPitch);
+    target.format = pixelFormat;
 
-    // Convert image data from RGB to BGRA
-    for (int y = 0; y < height; ++y)
+    if (rowOrder == BLP_ROW_ORDER_BOTTOM_UP)
     {
-      for (int x = 0; x < width; ++x)
-      {
-        int index = (y * width + x) * 3; // RGB is packed in 3 channels
-        pDst->b = pImageData[index];
-        pDst->g = pImageData[index + 1];
-        pDst->r = pImageData[index + 2];
-        pDst->a = 0xFF;
-
-        ++pDst;
-      }
+        target.pData += (blp_height(blpInfos, mipLevel) - 1) * dstPitch;
+        target.pitch = -target.pitch;
     }
 
-    stbi_image_free(pImageData); // Free the image data allocated by stb_image
-
-    return pBuffer;
+    return blp_convert_target(buffer, static_cast<tInternalBLPInfos*>(blpInfos), mipLevel, target);
 }
 
 
-tBGRAPixel* blp1_convert_paletted_separated_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
+uint8_t* blp_convert_all_mips(const char* buffer, tBLPInfos blpInfos, tBLPPixelFormat pixelFormat, size_t* offsets)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
+    unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
 
-    for (unsigned int y = 0; y < height; ++y)
+    offsets[0] = 0;
+    for (unsigned int mipLevel = 0; mipLevel < nbMipLevels; ++mipLevel)
+        offsets[mipLevel + 1] = offsets[mipLevel] + blp_required_size(pBLPInfos, mipLevel, pixelFormat);
+
+    uint8_t* pBuffer = new uint8_t[offsets[nbMipLevels]];
+
+    for (unsigned int mipLevel = 0; mipLevel < nbMipLevels; ++mipLevel)
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = *pAlpha;
+        tBLPTarget target;
+        target.pData  = pBuffer + offsets[mipLevel];
+        target.pitch  = blp_width(pBLPInfos, mipLevel) * blp_bytes_per_pixel(pixelFormat);
+        target.format = pixelFormat;
 
-            ++pIndices;
-            ++pAlpha;
-            ++pDst;
+        if (!blp_convert_target(buffer, pBLPInfos, mipLevel, target))
+        {
+            delete[] pBuffer;
+            return nullptr;
         }
     }
 
@@ -365,210 +438,253 @@ tBGRAPixel* blp1_convert_paletted_separated_alpha(uint8_t* pSrc, tBLP1Infos* pIn
 }
 
 
-tBGRAPixel* blp1_convert_paletted_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
+const uint8_t* blp_mip_data(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel, size_t* pSize)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
 
-    uint8_t* pIndices = pSrc;
+    // Check the mip level
+    unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
+    if (mipLevel >= nbMipLevels)
+        mipLevel = nbMipLevels - 1;
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = 0xFF - pDst->a;
+    uint32_t offset = (pBLPInfos->version == 2 ? pBLPInfos->blp2.offsets[mipLevel]
+                                               : pBLPInfos->blp1.header.offsets[mipLevel]);
+    uint32_t length = (pBLPInfos->version == 2 ? pBLPInfos->blp2.lengths[mipLevel]
+                                               : pBLPInfos->blp1.header.lengths[mipLevel]);
 
-            ++pIndices;
-            ++pDst;
-        }
-    }
+    // The stored length can include some padding
+    size_t size = blp_mip_level_size(pBLPInfos, blp_width(pBLPInfos, mipLevel), blp_height(pBLPInfos, mipLevel));
+    *pSize = (size > 0 ? size : length);
 
-    return pBuffer;
+    return reinterpret_cast<const uint8_t*>(buffer) + offset;
 }
 
 
-tBGRAPixel* blp1_convert_paletted_no_alpha(uint8_t* pSrc, tBLP1Infos* pInfos, unsigned int width, unsigned int height)
+// Where the alpha of a paletted file comes from
+static tBLPPaletteAlpha blp_palette_alpha(tInternalBLPInfos* pBLPInfos)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
-
-    uint8_t* pIndices = pSrc;
-
-    for (unsigned int y = 0; y < height; ++y)
+    switch (blp_format(pBLPInfos))
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pInfos->palette[*pIndices];
-            pDst->a = 0xFF;
+        case BLP_FORMAT_PALETTED_ALPHA_1:   return BLP_PALETTE_ALPHA_PLANE_1;
+        case BLP_FORMAT_PALETTED_ALPHA_4:   return BLP_PALETTE_ALPHA_PLANE_4;
 
-            ++pIndices;
-            ++pDst;
-        }
-    }
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            if ((pBLPInfos->version == 1) && (pBLPInfos->blp1.header.alphaEncoding == 5))
+                return BLP_PALETTE_ALPHA_INVERTED;
+            return BLP_PALETTE_ALPHA_PLANE_8;
 
-    return pBuffer;
+        default:                            return BLP_PALETTE_ALPHA_NONE;
+    }
 }
 
 
-tBGRAPixel* blp2_convert_paletted_no_alpha(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
+bool blp_convert_indexed(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel, uint8_t* pIndices,
+                         uint8_t* pPalette)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
 
-    for (unsigned int y = 0; y < height; ++y)
+    switch (blp_format(pBLPInfos))
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pSrc];
-            pDst->a = 0xFF;
-
-            ++pSrc;
-            ++pDst;
-        }
+        case BLP_FORMAT_PALETTED_NO_ALPHA:
+        case BLP_FORMAT_PALETTED_ALPHA_1:
+        case BLP_FORMAT_PALETTED_ALPHA_4:
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            break;
+
+        default:
+            return false;
     }
 
-    return pBuffer;
+    // Check the mip level
+    unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
+    if (mipLevel >= nbMipLevels)
+        mipLevel = nbMipLevels - 1;
+
+    uint32_t offset = (pBLPInfos->version == 2 ? pBLPInfos->blp2.offsets[mipLevel]
+                                               : pBLPInfos->blp1.header.offsets[mipLevel]);
+
+    const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(buffer) + offset;
+    const tBGRAPixel* pSrcPalette = (pBLPInfos->version == 2 ? pBLPInfos->blp2.palette : pBLPInfos->blp1.infos.palette);
+
+    return blp_extract_paletted(pSrc, pSrcPalette, blp_palette_alpha(pBLPInfos), blp_width(pBLPInfos, mipLevel),
+                                blp_height(pBLPInfos, mipLevel), pIndices, pPalette);
 }
 
 
-tBGRAPixel* blp2_convert_paletted_alpha8(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
+uint8_t* blp_convert_buffer_scaled(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel, unsigned int scale,
+                                   tBLPPixelFormat pixelFormat, unsigned int* pWidth, unsigned int* pHeight)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    tInternalBLPInfos* pBLPInfos = static_cast<tInternalBLPInfos*>(blpInfos);
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
+    unsigned int width  = blp_width(pBLPInfos, mipLevel);
+    unsigned int height = blp_height(pBLPInfos, mipLevel);
 
-    for (unsigned int y = 0; y < height; ++y)
+    if (scale == 1)
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = *pAlpha;
+        *pWidth  = width;
+        *pHeight = height;
+        return blp_convert_buffer_as(buffer, blpInfos, mipLevel, pixelFormat);
+    }
 
-            ++pIndices;
-            ++pAlpha;
-            ++pDst;
-        }
+    // Only the IDCT of the JPEG files can produce a reduced resolution directly
+    if (((scale != 2) && (scale != 4) && (scale != 8)) || (blp_format(pBLPInfos) != BLP_FORMAT_JPEG) ||
+        (pBLPInfos->version != 1) || !pBLPInfos->blp1.infos.jpeg.pTables)
+    {
+        return nullptr;
     }
 
-    return pBuffer;
-}
+    // Check the mip level
+    unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
+    if (mipLevel >= nbMipLevels)
+        mipLevel = nbMipLevels - 1;
 
+    *pWidth  = (width + scale - 1) / scale;
+    *pHeight = (height + scale - 1) / scale;
 
-tBGRAPixel* blp2_convert_paletted_alpha1(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    uint8_t* pBuffer = new uint8_t[size_t(*pWidth) * *pHeight * blp_bytes_per_pixel(pixelFormat)];
 
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
-    uint8_t counter = 0;
+    tBLPTarget target;
+    target.pData  = pBuffer;
+    target.pitch  = *pWidth * blp_bytes_per_pixel(pixelFormat);
+    target.format = pixelFormat;
 
-    for (unsigned int y = 0; y < height; ++y)
+    const tBLP1Infos& infos = pBLPInfos->blp1.infos;
+    const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(buffer) + pBLPInfos->blp1.header.offsets[mipLevel];
+
+    if (!blp1_decode_jpeg(infos.jpeg.pTables, infos.jpeg.header, infos.jpeg.headerSize, pSrc,
+                          pBLPInfos->blp1.header.lengths[mipLevel], width, height, scale, target))
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = (*pAlpha & (1 << counter) ? 0xFF : 0x00);
-
-            ++pIndices;
-            ++pDst;
-
-            ++counter;
-            if (counter == 8)
-            {
-                ++pAlpha;
-                counter = 0;
-            }
-        }
+        delete[] pBuffer;
+        return nullptr;
     }
 
     return pBuffer;
 }
 
-tBGRAPixel* blp2_convert_paletted_alpha4(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
-{
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
-
-    uint8_t* pIndices = pSrc;
-    uint8_t* pAlpha = pSrc + width * height;
-    uint8_t counter = 0;
 
-    for (unsigned int y = 0; y < height; ++y)
-    {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            *pDst = pHeader->palette[*pIndices];
-            pDst->a = (*pAlpha >> counter) & 0xF;
+bool blp_convert_target(const char* buffer, tInternalBLPInfos* pBLPInfos, unsigned int mipLevel, const tBLPTarget& target)
+{
+    unsigned int width  = blp_width(pBLPInfos, mipLevel);
+    unsigned int height = blp_height(pBLPInfos, mipLevel);
 
-            // convert 4-bit range to 8-bit range
-            pDst->a = (pDst->a << 4) | pDst->a;
+    // Check the mip level
+    unsigned int nbMipLevels = blp_nb_mip_levels(pBLPInfos);
+    if (mipLevel >= nbMipLevels)
+        mipLevel = nbMipLevels - 1;
 
-            ++pIndices;
-            ++pDst;
+    uint32_t offset = (pBLPInfos->version == 2 ? pBLPInfos->blp2.offsets[mipLevel]
+                                               : pBLPInfos->blp1.header.offsets[mipLevel]);
+    uint32_t size   = (pBLPInfos->version == 2 ? pBLPInfos->blp2.lengths[mipLevel]
+                                               : pBLPInfos->blp1.header.lengths[mipLevel]);
 
-            counter += 4;
-            if (counter == 8)
-            {
-                ++pAlpha;
-                counter = 0;
-            }
-        }
-    }
+    const uint8_t* pSrc = reinterpret_cast<const uint8_t*>(buffer) + offset;
 
-    return pBuffer;
+    // All the formats are written straight into the target, so a failed decode can't be retried
+    return blp_decode_into_target(pSrc, size, pBLPInfos, width, height, target);
 }
 
-tBGRAPixel* blp2_convert_raw_bgra(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height)
+
+// Decodes a mip level straight into the target, returns false if the format is unknown or the data
+// is invalid
+bool blp_decode_into_target(const uint8_t* pSrc, uint32_t size, tInternalBLPInfos* pBLPInfos, unsigned int width,
+                            unsigned int height, const tBLPTarget& target)
 {
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
-    tBGRAPixel* pDst = pBuffer;
+    const tBGRAPixel* pPalette = (pBLPInfos->version == 2 ? pBLPInfos->blp2.palette : pBLPInfos->blp1.infos.palette);
 
-    for (unsigned int y = 0; y < height; ++y)
+    switch (blp_format(pBLPInfos))
     {
-        for (unsigned int x = 0; x < width; ++x)
-        {
-            pDst->b = pSrc[0];
-            pDst->g = pSrc[1];
-            pDst->r = pSrc[2];
-            pDst->a = pSrc[3];
-
-            pSrc += 4;
-            ++pDst;
-        }
+        case BLP_FORMAT_JPEG:
+            // JPEG compression isn't used by the BLP2 files
+            if ((pBLPInfos->version != 1) || !pBLPInfos->blp1.infos.jpeg.pTables)
+                return false;
+
+            return blp1_decode_jpeg(pBLPInfos->blp1.infos.jpeg.pTables, pBLPInfos->blp1.infos.jpeg.header,
+                                    pBLPInfos->blp1.infos.jpeg.headerSize, pSrc, size, width, height, 1, target);
+
+        case BLP_FORMAT_PALETTED_NO_ALPHA:
+        case BLP_FORMAT_PALETTED_ALPHA_1:
+        case BLP_FORMAT_PALETTED_ALPHA_4:
+        case BLP_FORMAT_PALETTED_ALPHA_8:
+            blp_decode_paletted(pSrc, pPalette, blp_palette_alpha(pBLPInfos), width, height, target);
+            return true;
+
+        case BLP_FORMAT_DXT1_NO_ALPHA:
+        case BLP_FORMAT_DXT1_ALPHA_1:
+            blp2_decode_dxt(pSrc, width, height, squish::kDxt1, target);
+            return true;
+
+        case BLP_FORMAT_DXT3_ALPHA_4:
+        case BLP_FORMAT_DXT3_ALPHA_8:
+            blp2_decode_dxt(pSrc, width, height, squish::kDxt3, target);
+            return true;
+
+        case BLP_FORMAT_DXT5_ALPHA_8:
+            blp2_decode_dxt(pSrc, width, height, squish::kDxt5, target);
+            return true;
+
+        case BLP_FORMAT_RAW_BGRA:
+            // The pixels are stored with the layout of tBGRAPixel
+            if (size < size_t(width) * height * sizeof(tBGRAPixel))
+                return false;
+
+            blp_store_pixels(reinterpret_cast<const tBGRAPixel*>(pSrc), width, height, target);
+            return true;
+
+        default:
+            return false;
     }
-
-    return pBuffer;
 }
 
-tBGRAPixel* blp2_convert_dxt(uint8_t* pSrc, tBLP2Header* pHeader, unsigned int width, unsigned int height, int flags)
+
+std::string blp_as_string(tBLPFormat format)
 {
-    squish::u8* rgba = new squish::u8[width * height * 4];
-    tBGRAPixel* pBuffer = new tBGRAPixel[width * height];
+    switch (format)
+    {
+        case BLP_FORMAT_JPEG:              return "JPEG";
+        case BLP_FORMAT_PALETTED_NO_ALPHA: return "Uncompressed paletted image, no alpha";
+        case BLP_FORMAT_PALETTED_ALPHA_1:  return "Uncompressed paletted image, 1-bit alpha";
+        case BLP_FORMAT_PALETTED_ALPHA_4:  return "Uncompressed paletted image, 4-bit alpha";
+        case BLP_FORMAT_PALETTED_ALPHA_8:  return "Uncompressed paletted image, 8-bit alpha";
+        case BLP_FORMAT_RAW_BGRA:          return "Uncompressed raw 32-bit BGRA";
+        case BLP_FORMAT_DXT1_NO_ALPHA:     return "DXT1, no alpha";
+        case BLP_FORMAT_DXT1_ALPHA_1:      return "DXT1, 1-bit alpha";
+        case BLP_FORMAT_DXT3_ALPHA_4:      return "DXT3, 4-bit alpha";
+        case BLP_FORMAT_DXT3_ALPHA_8:      return "DXT3, 8-bit alpha";
+        case BLP_FORMAT_DXT5_ALPHA_8:      return "DXT5, 8-bit alpha";
+        default:                           return "Unknown";
+    }
+}
 
-    squish::u8* pSrc2 = rgba;
-    tBGRAPixel* pDst = pBuffer;
 
-    squish::DecompressImage(rgba, width, height, pSrc, flags);
+void blp_store_pixels(const tBGRAPixel* pSrc, unsigned int width, unsigned int height, const tBLPTarget& target)
+{
+    std::vector<uint8_t> row(target.format > BLP_PIXEL_FORMAT_RGBA8 ? size_t(width) * 4 : 0);
 
     for (unsigned int y = 0; y < height; ++y)
     {
+        uint8_t* pDst = target.pData + ptrdiff_t(y) * target.pitch;
+
+        if (target.format == BLP_PIXEL_FORMAT_BGRA8)
+        {
+            memcpy(pDst, pSrc, width * sizeof(tBGRAPixel));
+            pSrc += width;
+            continue;
+        }
+
+        // The other formats are converted from RGBA
+        uint8_t* pRGBA = (target.format == BLP_PIXEL_FORMAT_RGBA8 ? pDst : row.data());
+
         for (unsigned int x = 0; x < width; ++x)
         {
-            pDst->r = pSrc2[0];
-            pDst->g = pSrc2[1];
-            pDst->b = pSrc2[2];
-            pDst->a = pSrc2[3];
+            pRGBA[x * 4]     = pSrc->r;
+            pRGBA[x * 4 + 1] = pSrc->g;
+            pRGBA[x * 4 + 2] = pSrc->b;
+            pRGBA[x * 4 + 3] = pSrc->a;
 
-            pSrc2 += 4;
-            ++pDst;
+            ++pSrc;
         }
-    }
 
-    delete[] rgba;
-
-    return pBuffer;
+        if (target.format != BLP_PIXEL_FORMAT_RGBA8)
+            blp_convert_pixels(pRGBA, width, pDst, target.format);
+    }
 }
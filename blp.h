@@ -30,6 +30,9 @@ struct tBGRAPixel
 // Opaque type representing a BLP file
 typedef void* tBLPInfos;
 
+// Opaque type representing a BLP file mapped in memory
+typedef void* tBLPFile;
+
 
 enum tBLPEncoding
 {
@@ -75,6 +78,67 @@ enum tBLPFormat
 };
 
 
+// Layout of the pixels produced by the conversion functions
+enum tBLPPixelFormat
+{
+    BLP_PIXEL_FORMAT_BGRA8 = 0,     // Same layout than tBGRAPixel
+    BLP_PIXEL_FORMAT_RGBA8 = 1,
+    BLP_PIXEL_FORMAT_RGB8 = 2,      // 3 bytes per pixel, alpha dropped
+    BLP_PIXEL_FORMAT_RGBA8_PREMULTIPLIED = 3,
+};
+
+
+enum tBLPRowOrder
+{
+    BLP_ROW_ORDER_TOP_DOWN = 0,
+    BLP_ROW_ORDER_BOTTOM_UP = 1,
+};
+
+
+// Filter computing each mip level from the previous one
+enum tBLPMipFilter
+{
+    BLP_MIP_FILTER_BOX = 0,         // Average of the pixels covered by the destination one
+    BLP_MIP_FILTER_TRIANGLE = 1,    // Also takes the neighbour pixels into account, a bit smoother
+    BLP_MIP_FILTER_KAISER = 2,      // Windowed sinc, sharper (with a slight ringing on strong edges)
+};
+
+
+// Speed/quality tradeoff of the compression of the blocks
+enum tBLPEncodeQuality
+{
+    BLP_QUALITY_FAST = 0,       // Range fit: the colors are taken along the diagonal of their bounding box
+    BLP_QUALITY_NORMAL = 1,     // Cluster fit
+    BLP_QUALITY_BEST = 2,       // Iterative cluster fit, several times slower
+    BLP_QUALITY_ADAPTIVE = 3,   // Range fit for the blocks of nearly uniform colors, cluster fit elsewhere
+};
+
+
+struct tBLPEncodeOptions
+{
+    tBLPFormat      format = BLP_FORMAT_DXT5_ALPHA_8;   // One of the DXT formats
+    bool            bMipLevels = true;                  // All the mip levels down to 1x1
+    unsigned int    nbThreads = 0;                      // Compressing the blocks, 0: one per CPU core
+    tBLPMipFilter   mipFilter = BLP_MIP_FILTER_BOX;
+    bool            bSRGB = true;                       // The colors are averaged in linear space
+    bool            bAlphaWeighting = true;             // The colors are weighted by their alpha
+    tBLPEncodeQuality quality = BLP_QUALITY_NORMAL;
+    bool            bPerceptualMetric = true;           // Errors on green count more than on red and blue
+    bool            bWeightColorByAlpha = false;        // Errors on transparent pixels count less
+};
+
+
+// Measurements of blp_encode()
+struct tBLPEncodeStats
+{
+    unsigned int    nbBlocks;           // In all the mip levels
+    unsigned int    nbRangeFitBlocks;   // Compressed with the range fit
+    double          psnr;               // Of all the decoded mip levels (RGBA, without the colors
+                                        // of the pixels DXT1 makes transparent), in dB
+    double          seconds;            // Time spent compressing the blocks, summed over the threads
+};
+
+
 MODULE_API tBLPInfos blp_process_buffer(const char* buffer);
 MODULE_API void blp_release(tBLPInfos blpInfos);
 
@@ -87,10 +151,106 @@ MODULE_API unsigned int blp_nb_mip_levels(tBLPInfos blpInfos);
 
 MODULE_API tBGRAPixel* blp_convert_buffer(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel = 0);
 
+// Same as blp_convert_buffer(), but the pixels are produced directly in the requested format and
+// row order. The returned buffer (see blp_required_size()) must be freed with delete[].
+MODULE_API uint8_t* blp_convert_buffer_as(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                                          tBLPPixelFormat pixelFormat,
+                                          tBLPRowOrder rowOrder = BLP_ROW_ORDER_TOP_DOWN);
+
+// Converts a mip level at a reduced resolution: its dimensions divided by 'scale' (1, 2, 4 or 8),
+// rounded up, and written in 'pWidth' and 'pHeight'. Only the JPEG files support a scale other
+// than 1, which is then much faster than a full decode (1/8 only needs the DC coefficients).
+// Returns nullptr if the scale isn't supported. The returned buffer must be freed with delete[].
+MODULE_API uint8_t* blp_convert_buffer_scaled(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                                              unsigned int scale, tBLPPixelFormat pixelFormat,
+                                              unsigned int* pWidth, unsigned int* pHeight);
+
+// Size in bytes of the pixels of a mip level in the given format, with tightly packed rows
+MODULE_API size_t blp_required_size(tBLPInfos blpInfos, unsigned int mipLevel,
+                                    tBLPPixelFormat pixelFormat = BLP_PIXEL_FORMAT_BGRA8);
+
+// Converts a mip level into a buffer provided by the caller, whose rows are 'dstPitch' bytes apart
+// (at least the size of a row of pixels). Returns false if the format isn't supported.
+MODULE_API bool blp_convert_into(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                                 void* dst, size_t dstPitch, tBLPPixelFormat pixelFormat,
+                                 tBLPRowOrder rowOrder = BLP_ROW_ORDER_TOP_DOWN);
+
+// Converts all the mip levels at once into one buffer, where they are stored back to back (with
+// tightly packed rows, top-down). 'offsets' must have room for blp_nb_mip_levels() + 1 values: it
+// receives the position of each level in the buffer, followed by the total size. Each level is
+// decoded in place, without any temporary copy. The returned buffer must be freed with delete[].
+MODULE_API uint8_t* blp_convert_all_mips(const char* buffer, tBLPInfos blpInfos, tBLPPixelFormat pixelFormat,
+                                         size_t* offsets);
+
+// Data of a mip level as stored in the file, without any conversion (for instance the blocks of the
+// DXT formats), and its size in 'pSize'. Only the BLP1 JPEG files need more (the shared header).
+MODULE_API const uint8_t* blp_mip_data(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                                       size_t* pSize);
+
+// For the paletted formats, copies the indices of a mip level (one byte per pixel, with tightly
+// packed rows) and the 256 colors of the palette as RGBA values (1024 bytes). When the
+// alpha is stored apart from the indices, it is only possible if all the pixels using a color have
+// the same alpha, which is then given to that color. Returns false otherwise.
+MODULE_API bool blp_convert_indexed(const char* buffer, tBLPInfos blpInfos, unsigned int mipLevel,
+                                    uint8_t* pIndices, uint8_t* pPalette);
+
+// Converts the image at the biggest size fitting in 'maxWidth' x 'maxHeight' (keeping its aspect
+// ratio, never enlarged), written in 'pWidth' and 'pHeight'. Only the smallest mip level big enough
+// is decoded, then downscaled. The returned buffer must be freed with delete[].
+MODULE_API uint8_t* blp_convert_thumbnail(const char* buffer, tBLPInfos blpInfos, unsigned int maxWidth,
+                                          unsigned int maxHeight, tBLPPixelFormat pixelFormat,
+                                          unsigned int* pWidth, unsigned int* pHeight);
+
+// The mip level decoded by blp_convert_thumbnail() for these maximal dimensions
+MODULE_API unsigned int blp_thumbnail_mip_level(tBLPInfos blpInfos, unsigned int maxWidth, unsigned int maxHeight);
+
+// Downscales 4-channels pixels (in any order, with tightly packed rows) by averaging the source
+// pixels covered by each destination one. Returns false if the destination is bigger than the source.
+MODULE_API bool blp_downscale(const uint8_t* pSrc, unsigned int srcWidth, unsigned int srcHeight,
+                              uint8_t* pDst, unsigned int dstWidth, unsigned int dstHeight);
+
+// Encodes RGBA pixels (with tightly packed rows) as a BLP2 file, whose size is written in 'pSize'.
+// The mip levels are produced one at a time, each one being filtered from the previous one while
+// that one is compressed with squish, both by several threads: only two levels are kept in memory. BLP_FORMAT_DXT1_ALPHA_1 is written as
+// BLP_FORMAT_DXT1_NO_ALPHA if all the pixels are opaque. Returns nullptr if the format isn't a DXT
+// one. The returned buffer must be freed with delete[]. If 'pStats' isn't null, the blocks are also
+// decoded to measure the PSNR.
+MODULE_API uint8_t* blp_encode(const uint8_t* pPixels, unsigned int width, unsigned int height,
+                               const tBLPEncodeOptions& options, size_t* pSize,
+                               tBLPEncodeStats* pStats = nullptr);
+
+// Encodes an image file (PNG, TGA, or any format read by stb_image) as a BLP2 file
+MODULE_API bool blp_encode_file(const char* inPath, const char* outPath,
+                                const tBLPEncodeOptions& options = tBLPEncodeOptions(),
+                                tBLPEncodeStats* pStats = nullptr);
+
+// Reads only the header of a BLP file (in one small read), to get its informations without loading
+// it. The result can't be used to convert the BLP1 JPEG files. Release it with blp_release().
+MODULE_API tBLPInfos blp_probe_file(const char* path);
+
+// Maps a BLP file in memory: only the parts of the file actually read (the header and the
+// converted mip levels) are loaded. Returns nullptr if the file can't be opened or isn't a BLP.
+MODULE_API tBLPFile blp_open_file(const char* path);
+MODULE_API void blp_close_file(tBLPFile file);
+
+// Loads the pages of a mip level of a mapped file at once, so converting it doesn't wait for the
+// disk. Meant for the threads reading the files ahead of the ones converting them.
+MODULE_API void blp_prefetch_file(tBLPFile file, unsigned int mipLevel);
+
+// The informations about the file (released by blp_close_file()) and its content, to give to
+// the conversion functions
+MODULE_API tBLPInfos blp_file_infos(tBLPFile file);
+MODULE_API const char* blp_file_buffer(tBLPFile file);
+MODULE_API size_t blp_file_size(tBLPFile file);
+
 #ifdef __cplusplus
 }
 #endif
 
+// Same as blp_process_buffer(), but the header and the position of all the mip levels are checked
+// against the size of the buffer. Returns nullptr if the file is truncated or corrupted.
+MODULE_API tBLPInfos blp_process_buffer(const char* buffer, size_t size);
+
 std::string blp_as_string(tBLPFormat format);
 
 #endif
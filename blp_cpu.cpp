@@ -0,0 +1,50 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#if BLP_USE_AVX2 && defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+
+static tBLPCpuLevel blp_detect_cpu_level()
+{
+#if BLP_USE_AVX2
+#   if defined(_MSC_VER)
+    int infos[4];
+
+    __cpuid(infos, 0);
+    if (infos[0] >= 7)
+    {
+        // AVX2 needs the OS to save the YMM registers (OSXSAVE + XCR0)
+        __cpuid(infos, 1);
+        bool bOSXSave = ((infos[2] & (1 << 27)) != 0);
+        bool bAVX     = ((infos[2] & (1 << 28)) != 0);
+
+        if (bOSXSave && bAVX && ((_xgetbv(0) & 0x6) == 0x6))
+        {
+            __cpuidex(infos, 7, 0);
+            if ((infos[1] & (1 << 5)) != 0)
+                return BLP_CPU_AVX2;
+        }
+    }
+#   else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return BLP_CPU_AVX2;
+#   endif
+#endif
+
+#if BLP_USE_SSE2
+    return BLP_CPU_SSE2;
+#else
+    return BLP_CPU_SCALAR;
+#endif
+}
+
+
+tBLPCpuLevel blp_cpu_level()
+{
+    static const tBLPCpuLevel level = blp_detect_cpu_level();
+    return level;
+}
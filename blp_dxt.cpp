@@ -0,0 +1,386 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#include <squish.h>
+#include <algorithm>
+#include <cstring>
+
+
+/*********************************** SCALAR ***********************************/
+
+// Reference implementation, using squish
+template<int FLAGS>
+static void blp_dxt_decode_block_scalar(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    squish::u8 rgba[16 * 4];
+
+    squish::Decompress(rgba, pBlock, FLAGS);
+
+    for (unsigned int row = 0; row < 4; ++row)
+    {
+        const squish::u8* pPixel = rgba + row * 16;
+        uint8_t* pRow = pDst + row * pitch;
+
+        if (!bSwapRB)
+        {
+            memcpy(pRow, pPixel, 16);
+            continue;
+        }
+
+        for (unsigned int column = 0; column < 4; ++column)
+        {
+            pRow[0] = pPixel[2];
+            pRow[1] = pPixel[1];
+            pRow[2] = pPixel[0];
+            pRow[3] = pPixel[3];
+
+            pPixel += 4;
+            pRow += 4;
+        }
+    }
+}
+
+
+/************************************ SSE2 ************************************/
+
+#if BLP_USE_SSE2
+
+// Returns the 4 colours of the palette of a colour block, in the output channel order
+static inline __m128i blp_dxt_colour_palette_sse2(const uint8_t* pColourBlock, bool bDxt1, bool bSwapRB)
+{
+    const int c0 = pColourBlock[0] | (pColourBlock[1] << 8);
+    const int c1 = pColourBlock[2] | (pColourBlock[3] << 8);
+
+    // Move each 5- or 6-bits component at the top of its own 16-bits lane, and expand it to
+    // 8 bits by replicating its highest bits: (x << 3) | (x >> 2) for red and blue,
+    // (x << 2) | (x >> 4) for green
+    const __m128i endpoints = _mm_setr_epi16(short(c0), short(c0), short(c0), 0, short(c1), short(c1), short(c1), 0);
+
+    const __m128i multipliers = (bSwapRB ? _mm_setr_epi16(2048, 32, 1, 0, 2048, 32, 1, 0)
+                                         : _mm_setr_epi16(1, 32, 2048, 0, 1, 32, 2048, 0));
+
+    const __m128i masks = _mm_setr_epi16(short(0xF800), short(0xFC00), short(0xF800), 0,
+                                         short(0xF800), short(0xFC00), short(0xF800), 0);
+
+    const __m128i top = _mm_and_si128(_mm_mullo_epi16(endpoints, multipliers), masks);
+
+    __m128i colours = _mm_or_si128(_mm_srli_epi16(top, 8), _mm_mulhi_epu16(top, _mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0)));
+    colours = _mm_or_si128(colours, _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+
+    // Interpolated colours. The divisions are done with multiplications, exact on the range
+    // of values involved: (x * 21846) >> 16 == x / 3 for x <= 765
+    const __m128i swapped = _mm_shuffle_epi32(colours, _MM_SHUFFLE(1, 0, 3, 2));
+
+    __m128i middle;
+    if (!bDxt1 || (c0 > c1))
+    {
+        middle = _mm_add_epi16(_mm_add_epi16(colours, colours), swapped);
+        middle = _mm_mulhi_epu16(middle, _mm_set1_epi16(21846));
+    }
+    else
+    {
+        middle = _mm_srli_epi16(_mm_add_epi16(colours, swapped), 1);
+        middle = _mm_unpacklo_epi64(middle, _mm_setzero_si128());
+    }
+
+    return _mm_packus_epi16(colours, middle);
+}
+
+
+// Returns the 8 codes of the palette of a DXT5 alpha block, in 16-bits lanes
+static inline __m128i blp_dxt5_alpha_palette_sse2(const uint8_t* pAlphaBlock)
+{
+    const int alpha0 = pAlphaBlock[0];
+    const int alpha1 = pAlphaBlock[1];
+
+    const __m128i a0 = _mm_set1_epi16(short(alpha0));
+    const __m128i a1 = _mm_set1_epi16(short(alpha1));
+
+    // (x * 9363) >> 16 == x / 7 for x <= 1785, (x * 13108) >> 16 == x / 5 for x <= 1275
+    if (alpha0 > alpha1)
+    {
+        const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+                                          _mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+
+        return _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+    }
+
+    const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+                                      _mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+
+    return _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+}
+
+
+static inline __m128i blp_dxt_select_sse2(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+// Writes the colours of a block, by selecting the palette entries with the bits of the indices
+template<bool ALPHA>
+static inline void blp_dxt_write_colours_sse2(const uint8_t* pColourBlock, __m128i palette, const uint8_t* pAlpha,
+                                              uint8_t* pDst, ptrdiff_t pitch)
+{
+    const __m128i p0 = _mm_shuffle_epi32(palette, 0x00);
+    const __m128i p1 = _mm_shuffle_epi32(palette, 0x55);
+    const __m128i p2 = _mm_shuffle_epi32(palette, 0xAA);
+    const __m128i p3 = _mm_shuffle_epi32(palette, 0xFF);
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowBits = _mm_setr_epi32(1, 4, 16, 64);
+    const __m128i highBits = _mm_setr_epi32(2, 8, 32, 128);
+
+    for (unsigned int row = 0; row < 4; ++row)
+    {
+        const __m128i bits = _mm_set1_epi32(pColourBlock[4 + row]);
+
+        const __m128i lowClear = _mm_cmpeq_epi32(_mm_and_si128(bits, lowBits), zero);
+        const __m128i highClear = _mm_cmpeq_epi32(_mm_and_si128(bits, highBits), zero);
+
+        __m128i pixels = blp_dxt_select_sse2(highClear, blp_dxt_select_sse2(lowClear, p0, p1),
+                                             blp_dxt_select_sse2(lowClear, p2, p3));
+
+        if (ALPHA)
+        {
+            // Move the 4 alpha values of the row in the highest byte of each pixel
+            int alpha;
+            memcpy(&alpha, pAlpha + row * 4, 4);
+
+            __m128i alphas = _mm_unpacklo_epi8(zero, _mm_cvtsi32_si128(alpha));
+            alphas = _mm_unpacklo_epi16(zero, alphas);
+
+            pixels = _mm_or_si128(_mm_and_si128(pixels, _mm_set1_epi32(0x00FFFFFF)), alphas);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + row * pitch), pixels);
+    }
+}
+
+
+static void blp_dxt1_decode_block_sse2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    const __m128i palette = blp_dxt_colour_palette_sse2(pBlock, true, bSwapRB);
+    blp_dxt_write_colours_sse2<false>(pBlock, palette, nullptr, pDst, pitch);
+}
+
+
+static void blp_dxt3_decode_block_sse2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    // Expand the 4-bits alpha values to 8 bits: (x << 4) | x
+    const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pBlock));
+    const __m128i low = _mm_and_si128(packed, _mm_set1_epi8(0x0F));
+    const __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), _mm_set1_epi8(0x0F));
+    const __m128i nibbles = _mm_unpacklo_epi8(low, high);
+
+    uint8_t alphas[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(alphas), _mm_or_si128(nibbles, _mm_slli_epi16(nibbles, 4)));
+
+    const __m128i palette = blp_dxt_colour_palette_sse2(pBlock + 8, false, bSwapRB);
+    blp_dxt_write_colours_sse2<true>(pBlock + 8, palette, alphas, pDst, pitch);
+}
+
+
+static void blp_dxt5_decode_block_sse2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    uint16_t codes[8];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(codes), blp_dxt5_alpha_palette_sse2(pBlock));
+
+    // 16 indices of 3 bits
+    uint64_t indices = 0;
+    for (unsigned int i = 0; i < 6; ++i)
+        indices |= uint64_t(pBlock[2 + i]) << (8 * i);
+
+    uint8_t alphas[16];
+    for (unsigned int i = 0; i < 16; ++i)
+        alphas[i] = uint8_t(codes[(indices >> (3 * i)) & 0x7]);
+
+    const __m128i palette = blp_dxt_colour_palette_sse2(pBlock + 8, false, bSwapRB);
+    blp_dxt_write_colours_sse2<true>(pBlock + 8, palette, alphas, pDst, pitch);
+}
+
+#endif
+
+
+/************************************ AVX2 ************************************/
+
+#if BLP_USE_AVX2
+
+// Looks up the colours of two rows of pixels (8 indices of 2 bits)
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_colours_avx2(__m256i palette, uint32_t indices)
+{
+    const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+
+    const __m256i index = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(indices)), shifts),
+                                           _mm256_set1_epi32(0x3));
+
+    return _mm256_permutevar8x32_epi32(palette, index);
+}
+
+
+BLP_TARGET_AVX2 static inline __m256i blp_dxt_merge_alpha_avx2(__m256i pixels, __m256i alphas)
+{
+    return _mm256_or_si256(_mm256_and_si256(pixels, _mm256_set1_epi32(0x00FFFFFF)), _mm256_slli_epi32(alphas, 24));
+}
+
+
+BLP_TARGET_AVX2 static inline void blp_dxt_store_rows_avx2(uint8_t* pDst, ptrdiff_t pitch, __m256i pixels)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), _mm256_castsi256_si128(pixels));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + pitch), _mm256_extracti128_si256(pixels, 1));
+}
+
+
+static inline uint32_t blp_dxt_colour_indices(const uint8_t* pColourBlock)
+{
+    uint32_t indices;
+    memcpy(&indices, pColourBlock + 4, 4);
+    return indices;
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt1_decode_block_avx2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    const __m256i palette = _mm256_broadcastsi128_si256(blp_dxt_colour_palette_sse2(pBlock, true, bSwapRB));
+    const uint32_t indices = blp_dxt_colour_indices(pBlock);
+
+    blp_dxt_store_rows_avx2(pDst, pitch, blp_dxt_colours_avx2(palette, indices));
+    blp_dxt_store_rows_avx2(pDst + 2 * pitch, pitch, blp_dxt_colours_avx2(palette, indices >> 16));
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt3_decode_block_avx2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    const __m256i palette = _mm256_broadcastsi128_si256(blp_dxt_colour_palette_sse2(pBlock + 8, false, bSwapRB));
+    const uint32_t indices = blp_dxt_colour_indices(pBlock + 8);
+
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i mask = _mm256_set1_epi32(0xF);
+
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        // 8 alpha values of 4 bits, expanded to 8 bits: (x << 4) | x
+        uint32_t packed;
+        memcpy(&packed, pBlock + 4 * i, 4);
+
+        __m256i alphas = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(packed)), shifts), mask);
+        alphas = _mm256_or_si256(alphas, _mm256_slli_epi32(alphas, 4));
+
+        const __m256i pixels = blp_dxt_colours_avx2(palette, indices >> (16 * i));
+
+        blp_dxt_store_rows_avx2(pDst + 2 * i * pitch, pitch, blp_dxt_merge_alpha_avx2(pixels, alphas));
+    }
+}
+
+
+BLP_TARGET_AVX2 static void blp_dxt5_decode_block_avx2(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB)
+{
+    const __m256i palette = _mm256_broadcastsi128_si256(blp_dxt_colour_palette_sse2(pBlock + 8, false, bSwapRB));
+    const uint32_t indices = blp_dxt_colour_indices(pBlock + 8);
+
+    const __m256i codes = _mm256_cvtepu16_epi32(blp_dxt5_alpha_palette_sse2(pBlock));
+
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i mask = _mm256_set1_epi32(0x7);
+
+    for (unsigned int i = 0; i < 2; ++i)
+    {
+        // 8 alpha indices of 3 bits
+        const uint8_t* pIndices = pBlock + 2 + 3 * i;
+        const uint32_t packed = pIndices[0] | (pIndices[1] << 8) | (pIndices[2] << 16);
+
+        const __m256i alphaIndices = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(packed)), shifts), mask);
+        const __m256i alphas = _mm256_permutevar8x32_epi32(codes, alphaIndices);
+
+        const __m256i pixels = blp_dxt_colours_avx2(palette, indices >> (16 * i));
+
+        blp_dxt_store_rows_avx2(pDst + 2 * i * pitch, pitch, blp_dxt_merge_alpha_avx2(pixels, alphas));
+    }
+}
+
+#endif
+
+
+/********************************** DISPATCH **********************************/
+
+tDXTBlockDecoder blp_dxt_block_decoder(int flags, tBLPCpuLevel level)
+{
+#if BLP_USE_AVX2
+    if (level >= BLP_CPU_AVX2)
+    {
+        if ((flags & squish::kDxt1) != 0)
+            return blp_dxt1_decode_block_avx2;
+        if ((flags & squish::kDxt3) != 0)
+            return blp_dxt3_decode_block_avx2;
+        return blp_dxt5_decode_block_avx2;
+    }
+#endif
+
+#if BLP_USE_SSE2
+    if (level >= BLP_CPU_SSE2)
+    {
+        if ((flags & squish::kDxt1) != 0)
+            return blp_dxt1_decode_block_sse2;
+        if ((flags & squish::kDxt3) != 0)
+            return blp_dxt3_decode_block_sse2;
+        return blp_dxt5_decode_block_sse2;
+    }
+#endif
+
+    if ((flags & squish::kDxt1) != 0)
+        return blp_dxt_decode_block_scalar<squish::kDxt1>;
+    if ((flags & squish::kDxt3) != 0)
+        return blp_dxt_decode_block_scalar<squish::kDxt3>;
+    return blp_dxt_decode_block_scalar<squish::kDxt5>;
+}
+
+
+// Decodes each 4x4 block and writes it straight at its place in the target
+void blp2_decode_dxt(const uint8_t* pSrc, unsigned int width, unsigned int height, int flags, const tBLPTarget& target)
+{
+    const tDXTBlockDecoder decode = blp_dxt_block_decoder(flags, blp_cpu_level());
+    const unsigned int blockSize = ((flags & squish::kDxt1) != 0 ? 8 : 16);
+    const bool bSwapRB = (target.format == BLP_PIXEL_FORMAT_BGRA8);
+    const unsigned int bytesPerPixel = blp_bytes_per_pixel(target.format);
+
+    // The decoders only produce RGBA and BGRA, the other formats are converted block per block
+    const bool bDirect = (target.format == BLP_PIXEL_FORMAT_RGBA8) || bSwapRB;
+
+    uint8_t block[16 * 4];
+
+    for (unsigned int y = 0; y < height; y += 4)
+    {
+        const unsigned int nbRows = std::min(4u, height - y);
+
+        for (unsigned int x = 0; x < width; x += 4)
+        {
+            const unsigned int nbColumns = std::min(4u, width - x);
+
+            uint8_t* pDst = target.pData + ptrdiff_t(y) * target.pitch + x * bytesPerPixel;
+
+            if (bDirect && (nbRows == 4) && (nbColumns == 4))
+            {
+                decode(pSrc, pDst, target.pitch, bSwapRB);
+            }
+            else if (bDirect)
+            {
+                // Block on the border of the image
+                decode(pSrc, block, 16, bSwapRB);
+
+                for (unsigned int row = 0; row < nbRows; ++row)
+                    memcpy(pDst + row * target.pitch, block + row * 16, nbColumns * 4);
+            }
+            else
+            {
+                decode(pSrc, block, 16, false);
+
+                for (unsigned int row = 0; row < nbRows; ++row)
+                    blp_convert_pixels(block + row * 16, nbColumns, pDst + row * target.pitch, target.format);
+            }
+
+            pSrc += blockSize;
+        }
+    }
+}
@@ -0,0 +1,413 @@
+#include "blp.h"
+#include "blp_internal.h"
+
+// The implementation of stb_image is in blp_jpeg.cpp
+#include <stb_image.h>
+#include <squish.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+// Number of rows of a mip level filtered by a task
+static const unsigned int MIP_BAND_HEIGHT = 16;
+
+// Highest sum of the variances of the channels of the colors of a block compressed with the range
+// fit by BLP_QUALITY_ADAPTIVE
+static const int FLAT_BLOCK_VARIANCE = 48;
+
+
+// A mip level to compress, and where its blocks go in the file
+struct tBLPEncodeLevel
+{
+    const uint8_t*  pPixels;
+    unsigned int    width;
+    unsigned int    height;
+    uint8_t*        pBlocks;
+};
+
+
+// How the blocks are compressed
+struct tBLPBlockSettings
+{
+    int             flags;          // For squish, with the fit used by the blocks that aren't flat
+    unsigned int    bytesPerBlock;
+    bool            bOpaque;        // DXT1 without alpha
+    bool            bAdaptive;      // The flat blocks use the range fit
+    bool            bMeasure;       // The blocks are decoded to measure their error
+};
+
+
+// Measurements of a row of blocks
+struct tBLPBlockRowStats
+{
+    uint64_t        squaredError;
+    uint64_t        nbValues;           // Taken into account by 'squaredError'
+    unsigned int    nbRangeFitBlocks;
+    uint64_t        nanoseconds;        // Spent compressing the blocks
+};
+
+
+// Whether the colors of a block are close enough to each other (the sum of the variances of their
+// channels being low) for the range fit to be as good as the cluster fit. The pixels ignored by
+// squish (masked, or transparent with DXT1) don't count.
+static bool blp_is_flat_block(const uint8_t* rgba, int mask, bool bDXT1)
+{
+    int count = 0;
+    int sums[3] = { 0, 0, 0 };
+    int squares[3] = { 0, 0, 0 };
+
+    for (unsigned int i = 0; i < 16; ++i)
+    {
+        if (((mask & (1 << i)) == 0) || (bDXT1 && (rgba[i * 4 + 3] < 128)))
+            continue;
+
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            sums[c] += rgba[i * 4 + c];
+            squares[c] += rgba[i * 4 + c] * rgba[i * 4 + c];
+        }
+
+        ++count;
+    }
+
+    // count^2 * variance = count * sum(x^2) - sum(x)^2
+    int variances = 0;
+    for (unsigned int c = 0; c < 3; ++c)
+        variances += count * squares[c] - sums[c] * sums[c];
+
+    return variances <= FLAT_BLOCK_VARIANCE * count * count;
+}
+
+
+// Copies a 4x4 block of a mip level. Returns the mask of the pixels inside of the image, the other
+// ones being ignored by squish.
+static int blp_gather_block(const tBLPEncodeLevel& level, unsigned int blockX, unsigned int blockY, bool bOpaque,
+                            uint8_t* rgba)
+{
+    int mask = 0;
+
+    memset(rgba, 0, 16 * 4);
+
+    for (unsigned int y = 0; y < 4; ++y)
+    {
+        const unsigned int srcY = blockY * 4 + y;
+        if (srcY >= level.height)
+            break;
+
+        const unsigned int nbPixels = std::min(4u, level.width - blockX * 4);
+        memcpy(&rgba[y * 16], level.pPixels + (size_t(srcY) * level.width + blockX * 4) * 4, nbPixels * 4);
+
+        mask |= ((1 << nbPixels) - 1) << (y * 4);
+    }
+
+    // Without alpha, DXT1 must not use its transparent color
+    if (bOpaque)
+    {
+        for (unsigned int i = 0; i < 16; ++i)
+            rgba[i * 4 + 3] = 0xFF;
+    }
+
+    return mask;
+}
+
+
+// Compresses a row of 4x4 blocks. Only the compression is timed: the blocks are decoded to measure
+// their error afterwards.
+static tBLPBlockRowStats blp_compress_block_row(const tBLPEncodeLevel& level, unsigned int blockRow,
+                                                const tBLPBlockSettings& settings)
+{
+    const unsigned int nbBlocks = (level.width + 3) / 4;
+    uint8_t* pDst = level.pBlocks + size_t(blockRow) * nbBlocks * settings.bytesPerBlock;
+    const bool bDXT1 = ((settings.flags & squish::kDxt1) != 0);
+
+    tBLPBlockRowStats stats = { 0, 0, 0, 0 };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (unsigned int blockX = 0; blockX < nbBlocks; ++blockX)
+    {
+        uint8_t rgba[16 * 4];
+        const int mask = blp_gather_block(level, blockX, blockRow, settings.bOpaque, rgba);
+
+        int flags = settings.flags;
+        if (settings.bAdaptive && blp_is_flat_block(rgba, mask, bDXT1))
+        {
+            flags = (flags & ~squish::kColourClusterFit) | squish::kColourRangeFit;
+            ++stats.nbRangeFitBlocks;
+        }
+
+        squish::CompressMasked(rgba, mask, pDst + blockX * settings.bytesPerBlock, flags);
+    }
+
+    stats.nanoseconds = uint64_t(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+    if (!settings.bMeasure)
+        return stats;
+
+    for (unsigned int blockX = 0; blockX < nbBlocks; ++blockX)
+    {
+        uint8_t rgba[16 * 4];
+        const int mask = blp_gather_block(level, blockX, blockRow, settings.bOpaque, rgba);
+
+        uint8_t decoded[16 * 4];
+        squish::Decompress(decoded, pDst + blockX * settings.bytesPerBlock, settings.flags);
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            if ((mask & (1 << i)) == 0)
+                continue;
+
+            // With DXT1, squish writes the pixels with less than 50% of alpha as transparent black:
+            // their colors are invisible, only their alpha counts
+            const unsigned int firstChannel = ((bDXT1 && (rgba[i * 4 + 3] < 128)) ? 3 : 0);
+
+            for (unsigned int c = firstChannel; c < 4; ++c)
+            {
+                const int diff = int(decoded[i * 4 + c]) - int(rgba[i * 4 + c]);
+                stats.squaredError += uint64_t(diff * diff);
+            }
+
+            stats.nbValues += 4 - firstChannel;
+        }
+    }
+
+    return stats;
+}
+
+
+// Runs the tasks from 0 to 'nbTasks' - 1 on 'nbThreads' threads (the calling one included)
+template<typename T>
+static void blp_parallel_for(unsigned int nbTasks, unsigned int nbThreads, const T& task)
+{
+    std::atomic<unsigned int> nextTask(0);
+
+    auto run = [&]() {
+        for (unsigned int index = nextTask++; index < nbTasks; index = nextTask++)
+            task(index);
+    };
+
+    nbThreads = std::min(std::max(nbThreads, 1u), nbTasks);
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < nbThreads; ++i)
+        threads.emplace_back(run);
+
+    run();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+
+uint8_t* blp_encode(const uint8_t* pPixels, unsigned int width, unsigned int height,
+                    const tBLPEncodeOptions& options, size_t* pSize, tBLPEncodeStats* pStats)
+{
+    if ((width == 0) || (height == 0))
+        return nullptr;
+
+    tBLPFormat format = options.format;
+    int flags;
+    unsigned int bytesPerBlock = 16;
+
+    switch (format)
+    {
+        case BLP_FORMAT_DXT1_NO_ALPHA:
+        case BLP_FORMAT_DXT1_ALPHA_1:
+            flags = squish::kDxt1;
+            bytesPerBlock = 8;
+            break;
+
+        case BLP_FORMAT_DXT3_ALPHA_4:
+        case BLP_FORMAT_DXT3_ALPHA_8:
+            flags = squish::kDxt3;
+            break;
+
+        case BLP_FORMAT_DXT5_ALPHA_8:
+            flags = squish::kDxt5;
+            break;
+
+        default:
+            return nullptr;
+    }
+
+    if (format == BLP_FORMAT_DXT1_ALPHA_1)
+    {
+        bool bOpaque = true;
+        for (size_t i = 0; bOpaque && (i < size_t(width) * height); ++i)
+            bOpaque = (pPixels[i * 4 + 3] == 0xFF);
+
+        if (bOpaque)
+            format = BLP_FORMAT_DXT1_NO_ALPHA;
+    }
+
+    // Down to 1x1 (at most 16 levels), each dimension being halved (rounded down) from a level to
+    // the next
+    unsigned int nbMipLevels = 1;
+    if (options.bMipLevels)
+    {
+        while ((nbMipLevels < 16) && (std::max(width, height) >> nbMipLevels) > 0)
+            ++nbMipLevels;
+    }
+
+    tBLP2Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "BLP2", 4);
+    header.type             = 1;
+    header.encoding         = BLP_ENCODING_DXT;
+    header.alphaDepth       = uint8_t((format >> 8) & 0xFF);
+    header.alphaEncoding    = uint8_t(format & 0xFF);
+    header.hasMipLevels     = (nbMipLevels > 1 ? 1 : 0);
+    header.width            = width;
+    header.height           = height;
+
+    size_t size = sizeof(tBLP2Header);
+
+    for (unsigned int mipLevel = 0; mipLevel < nbMipLevels; ++mipLevel)
+    {
+        const size_t length = size_t((std::max(width >> mipLevel, 1u) + 3) / 4) *
+                              ((std::max(height >> mipLevel, 1u) + 3) / 4) * bytesPerBlock;
+
+        header.offsets[mipLevel] = uint32_t(size);
+        header.lengths[mipLevel] = uint32_t(length);
+        size += length;
+    }
+
+    uint8_t* pBuffer = new uint8_t[size];
+    memcpy(pBuffer, &header, sizeof(header));
+
+    tBLPBlockSettings settings;
+    settings.flags          = flags | (options.bWeightColorByAlpha ? squish::kWeightColourByAlpha : 0) |
+                              (options.bPerceptualMetric ? squish::kColourMetricPerceptual
+                                                         : squish::kColourMetricUniform);
+    settings.bytesPerBlock  = bytesPerBlock;
+    settings.bOpaque        = (format == BLP_FORMAT_DXT1_NO_ALPHA);
+    settings.bAdaptive      = (options.quality == BLP_QUALITY_ADAPTIVE);
+    settings.bMeasure       = (pStats != nullptr);
+
+    switch (options.quality)
+    {
+        case BLP_QUALITY_FAST:  settings.flags |= squish::kColourRangeFit; break;
+        case BLP_QUALITY_BEST:  settings.flags |= squish::kColourIterativeClusterFit; break;
+        default:                settings.flags |= squish::kColourClusterFit; break;
+    }
+
+    std::atomic<uint64_t> squaredError(0);
+    std::atomic<uint64_t> nbValues(0);
+    std::atomic<unsigned int> nbRangeFitBlocks(0);
+    std::atomic<uint64_t> nanoseconds(0);
+    unsigned int nbBlocks = 0;
+
+    const unsigned int nbThreads = (options.nbThreads > 0 ? options.nbThreads : std::thread::hardware_concurrency());
+
+    // Only the level being compressed and the next one (filtered from it at the same time) are kept
+    // in memory
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> next;
+
+    tBLPEncodeLevel level = { pPixels, width, height, nullptr };
+
+    for (unsigned int mipLevel = 0; mipLevel < nbMipLevels; ++mipLevel)
+    {
+        level.pBlocks = pBuffer + header.offsets[mipLevel];
+
+        tBLPMipLevel mip;
+        unsigned int nbBands = 0;
+
+        if (mipLevel + 1 < nbMipLevels)
+        {
+            mip.pSrc            = level.pPixels;
+            mip.srcWidth        = level.width;
+            mip.srcHeight       = level.height;
+            mip.dstWidth        = std::max(level.width >> 1, 1u);
+            mip.dstHeight       = std::max(level.height >> 1, 1u);
+            mip.bSRGB           = options.bSRGB;
+            mip.bAlphaWeighting = options.bAlphaWeighting;
+
+            next.resize(size_t(mip.dstWidth) * mip.dstHeight * 4);
+            mip.pDst = next.data();
+
+            blp_mip_prepare(options.mipFilter, mip);
+            nbBands = (mip.dstHeight + MIP_BAND_HEIGHT - 1) / MIP_BAND_HEIGHT;
+        }
+
+        const unsigned int nbBlockRows = (level.height + 3) / 4;
+
+        blp_parallel_for(nbBands + nbBlockRows, nbThreads, [&](unsigned int task) {
+            if (task < nbBands)
+            {
+                blp_mip_filter_rows(mip, task * MIP_BAND_HEIGHT, MIP_BAND_HEIGHT);
+            }
+            else
+            {
+                const tBLPBlockRowStats stats = blp_compress_block_row(level, task - nbBands, settings);
+                squaredError += stats.squaredError;
+                nbValues += stats.nbValues;
+                nbRangeFitBlocks += stats.nbRangeFitBlocks;
+                nanoseconds += stats.nanoseconds;
+            }
+        });
+
+        nbBlocks += nbBlockRows * ((level.width + 3) / 4);
+
+        if (nbBands > 0)
+        {
+            current.swap(next);
+            level.pPixels = current.data();
+            level.width   = mip.dstWidth;
+            level.height  = mip.dstHeight;
+        }
+    }
+
+    if (pStats)
+    {
+        const double meanError = (nbValues > 0 ? double(squaredError) / double(nbValues) : 0.0);
+
+        pStats->nbBlocks         = nbBlocks;
+        pStats->nbRangeFitBlocks = (options.quality == BLP_QUALITY_FAST ? nbBlocks : unsigned(nbRangeFitBlocks));
+        pStats->psnr             = (meanError > 0.0 ? 10.0 * log10(255.0 * 255.0 / meanError) : INFINITY);
+        pStats->seconds          = double(nanoseconds) * 1e-9;
+    }
+
+    *pSize = size;
+    return pBuffer;
+}
+
+
+bool blp_encode_file(const char* inPath, const char* outPath, const tBLPEncodeOptions& options,
+                     tBLPEncodeStats* pStats)
+{
+    int width;
+    int height;
+    int nbChannels;
+
+    uint8_t* pPixels = stbi_load(inPath, &width, &height, &nbChannels, 4);
+    if (!pPixels)
+        return false;
+
+    size_t size;
+    uint8_t* pBuffer = blp_encode(pPixels, unsigned(width), unsigned(height), options, &size, pStats);
+    stbi_image_free(pPixels);
+
+    if (!pBuffer)
+        return false;
+
+    FILE* pFile = fopen(outPath, "wb");
+
+    bool bSuccess = (pFile != nullptr);
+    if (pFile)
+    {
+        bSuccess = (fwrite(pBuffer, 1, size, pFile) == size);
+        bSuccess = (fclose(pFile) == 0) && bSuccess;
+    }
+
+    delete[] pBuffer;
+
+    return bSuccess;
+}
@@ -0,0 +1,219 @@
+#include "blp.h"
+#include "blp_internal.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+
+// A BLP file mapped in memory
+struct tBLPMappedFile
+{
+    const char* pData;
+    size_t      size;
+    tBLPInfos   infos;
+
+#ifdef _WIN32
+    HANDLE      hMapping;
+#endif
+};
+
+
+static bool blp_map_file(const char* path, tBLPMappedFile* pFile)
+{
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || (size.QuadPart == 0))
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    // The mapping keeps the file open
+    pFile->hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(hFile);
+
+    if (!pFile->hMapping)
+        return false;
+
+    pFile->pData = static_cast<const char*>(MapViewOfFile(pFile->hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!pFile->pData)
+    {
+        CloseHandle(pFile->hMapping);
+        return false;
+    }
+
+    pFile->size = size_t(size.QuadPart);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat infos;
+    if ((fstat(fd, &infos) != 0) || (infos.st_size == 0))
+    {
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file open
+    void* pData = mmap(nullptr, size_t(infos.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (pData == MAP_FAILED)
+        return false;
+
+    // Only the header and the requested mip level are usually read, so don't let the kernel
+    // read ahead the rest of the file
+    madvise(pData, size_t(infos.st_size), MADV_RANDOM);
+
+    pFile->pData = static_cast<const char*>(pData);
+    pFile->size = size_t(infos.st_size);
+#endif
+
+    return true;
+}
+
+
+static void blp_unmap_file(tBLPMappedFile* pFile)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(pFile->pData);
+    CloseHandle(pFile->hMapping);
+#else
+    munmap(const_cast<char*>(pFile->pData), pFile->size);
+#endif
+}
+
+
+tBLPFile blp_open_file(const char* path)
+{
+    auto* pFile = new tBLPMappedFile();
+
+    if (!blp_map_file(path, pFile))
+    {
+        delete pFile;
+        return nullptr;
+    }
+
+    // The offsets of the mip levels are checked, so the mapping can be decoded without copy even
+    // if the file is corrupted
+    pFile->infos = blp_process_buffer(pFile->pData, pFile->size);
+    if (!pFile->infos)
+    {
+        blp_unmap_file(pFile);
+        delete pFile;
+        return nullptr;
+    }
+
+    return (tBLPFile) pFile;
+}
+
+
+tBLPInfos blp_probe_file(const char* path)
+{
+    // Everything needed is in the first bytes of the file (the BLP2 header being the biggest one)
+    char header[sizeof(tBLP2Header)];
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    DWORD nbRead = 0;
+    BOOL bSuccess = ReadFile(hFile, header, sizeof(header), &nbRead, nullptr);
+    CloseHandle(hFile);
+
+    if (!bSuccess)
+        return nullptr;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    ssize_t nbRead = pread(fd, header, sizeof(header), 0);
+    close(fd);
+
+    if (nbRead < 0)
+        return nullptr;
+#endif
+
+    return (tBLPInfos) blp_process_header(header, size_t(nbRead), true);
+}
+
+
+void blp_close_file(tBLPFile file)
+{
+    tBLPMappedFile* pFile = static_cast<tBLPMappedFile*>(file);
+
+    blp_release(pFile->infos);
+    blp_unmap_file(pFile);
+
+    delete pFile;
+}
+
+
+void blp_prefetch_file(tBLPFile file, unsigned int mipLevel)
+{
+    tBLPMappedFile* pFile = static_cast<tBLPMappedFile*>(file);
+
+    size_t size;
+    const uint8_t* pData = blp_mip_data(pFile->pData, pFile->infos, mipLevel, &size);
+    if (size == 0)
+        return;
+
+#ifdef _WIN32
+    SYSTEM_INFO system;
+    GetSystemInfo(&system);
+    const uintptr_t pageSize = system.dwPageSize;
+#else
+    const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+#endif
+
+    // The mapping starts on a page boundary, so the first page of the level is in it
+    const uintptr_t start = uintptr_t(pData) & ~(pageSize - 1);
+    const uintptr_t end = std::min(uintptr_t(pData) + size, uintptr_t(pFile->pData) + pFile->size);
+
+#ifndef _WIN32
+    // The mapping is read one page at a time (MADV_RANDOM), ask for the whole level in one go
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+#endif
+
+    // Wait until the pages are loaded, by reading a byte of each one of them
+    uint8_t sum = 0;
+    for (uintptr_t page = start; page < end; page += pageSize)
+        sum += *reinterpret_cast<const volatile uint8_t*>(page);
+
+    (void) sum;
+}
+
+
+tBLPInfos blp_file_infos(tBLPFile file)
+{
+    return static_cast<tBLPMappedFile*>(file)->infos;
+}
+
+
+const char* blp_file_buffer(tBLPFile file)
+{
+    return static_cast<tBLPMappedFile*>(file)->pData;
+}
+
+
+size_t blp_file_size(tBLPFile file)
+{
+    return static_cast<tBLPMappedFile*>(file)->size;
+}
@@ -1,9 +1,11 @@
 #ifndef _BLP_INTERNAL_H_
 #define _BLP_INTERNAL_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string>
+#include <vector>
 
 
 // A description of the BLP1 format can be found in the file doc/MagosBlpFormat.txt
@@ -21,6 +23,10 @@ struct tBLP1Header
 };
 
 
+// Tables of the JPEG header shared by all the mip levels of a BLP1 file (see blp_jpeg.cpp)
+struct tBLPJPEGTables;
+
+
 // Additional informations about a BLP1 file
 struct tBLP1Infos
 {
@@ -32,6 +38,7 @@ struct tBLP1Infos
         struct {
             uint32_t headerSize;
             uint8_t* header;        // Shared between all mipmap levels
+            tBLPJPEGTables* pTables;    // The tables of the header, parsed once
         } jpeg;
     };
 };
@@ -59,6 +66,102 @@ struct tBLP2Header
 };
 
 
+// Destination of a conversion: 'pData' points to the first row of the image, and the next rows
+// are 'pitch' bytes apart (negative when the rows are stored bottom-up)
+struct tBLPTarget
+{
+    uint8_t*        pData;
+    ptrdiff_t       pitch;
+    tBLPPixelFormat format;
+};
+
+
+// Instruction sets used by the optimized code paths
+enum tBLPCpuLevel
+{
+    BLP_CPU_SCALAR = 0,
+    BLP_CPU_SSE2 = 1,
+    BLP_CPU_AVX2 = 2,
+};
+
+
+unsigned int blp_bytes_per_pixel(tBLPPixelFormat format);
+
+// Converts RGBA pixels to another format (can be done in place)
+void blp_convert_pixels(const uint8_t* pSrc, unsigned int count, uint8_t* pDst, tBLPPixelFormat format);
+
+
+// Best instruction set usable on this CPU (detected once)
+tBLPCpuLevel blp_cpu_level();
+
+
+// Decodes one DXT block (8 or 16 bytes) as 4 rows of 4 pixels, 'pitch' bytes apart. The pixels
+// are RGBA, or BGRA if 'bSwapRB' is set.
+typedef void (*tDXTBlockDecoder)(const uint8_t* pBlock, uint8_t* pDst, ptrdiff_t pitch, bool bSwapRB);
+
+// 'flags' is one of squish::kDxt1, squish::kDxt3 or squish::kDxt5
+tDXTBlockDecoder blp_dxt_block_decoder(int flags, tBLPCpuLevel level);
+
+void blp2_decode_dxt(const uint8_t* pSrc, unsigned int width, unsigned int height, int flags, const tBLPTarget& target);
+
+
+// Parses the tables of the JPEG header of a BLP1 file. Returns nullptr if the header is invalid.
+tBLPJPEGTables* blp_jpeg_parse_header(const uint8_t* pHeader, uint32_t size);
+void blp_jpeg_release(tBLPJPEGTables* pTables);
+
+// Decodes a mip level of a BLP1 JPEG file, whose dimensions must match the JPEG frame. With a
+// 'scale' of 2, 4 or 8, the image is decoded at a reduced resolution (rounded up) by a scaled IDCT.
+bool blp1_decode_jpeg(const tBLPJPEGTables* pTables, const uint8_t* pHeader, uint32_t headerSize,
+                      const uint8_t* pSrc, uint32_t size, unsigned int width, unsigned int height,
+                      unsigned int scale, const tBLPTarget& target);
+
+
+// A mip level filtered from its parent (see blp_mipmap.cpp). The weights are computed once by
+// blp_mip_prepare(), then the rows can be produced in bands, by several threads.
+struct tBLPMipWeights
+{
+    unsigned int            nbTaps;
+    std::vector<unsigned>   firsts;     // Index of the first source pixel of each destination one
+    std::vector<float>      weights;    // 'nbTaps' per destination pixel, summing to 1
+};
+
+struct tBLPMipLevel
+{
+    const uint8_t*  pSrc;               // RGBA, with tightly packed rows
+    unsigned int    srcWidth;
+    unsigned int    srcHeight;
+    uint8_t*        pDst;
+    unsigned int    dstWidth;
+    unsigned int    dstHeight;
+    bool            bSRGB;
+    bool            bAlphaWeighting;
+    tBLPMipWeights  horizontal;
+    tBLPMipWeights  vertical;
+};
+
+void blp_mip_prepare(tBLPMipFilter filter, tBLPMipLevel& level);
+void blp_mip_filter_rows(const tBLPMipLevel& level, unsigned int firstRow, unsigned int nbRows);
+
+
+// Where the alpha values of a paletted image come from
+enum tBLPPaletteAlpha
+{
+    BLP_PALETTE_ALPHA_NONE,         // Opaque
+    BLP_PALETTE_ALPHA_INVERTED,     // 255 - alpha of the palette entry (BLP1)
+    BLP_PALETTE_ALPHA_PLANE_1,      // Plane of 1-, 4- or 8-bits values following the indices
+    BLP_PALETTE_ALPHA_PLANE_4,
+    BLP_PALETTE_ALPHA_PLANE_8,
+};
+
+void blp_decode_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tBLPPaletteAlpha alpha,
+                         unsigned int width, unsigned int height, const tBLPTarget& target);
+
+// Copies the indices of a paletted mip level, and the palette as RGBA colors. When the alpha comes
+// from a plane, each color gets the alpha of the pixels using it: returns false if they differ.
+bool blp_extract_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tBLPPaletteAlpha alpha,
+                          unsigned int width, unsigned int height, uint8_t* pIndices, uint8_t* pColors);
+
+
 // Internal representation of any BLP header
 struct tInternalBLPInfos
 {
@@ -74,4 +177,13 @@ struct tInternalBLPInfos
     };
 };
 
+
+// Parses the header of a BLP file of 'size' bytes (SIZE_MAX if unknown). With 'bHeaderOnly', the
+// JPEG header or the palette of the BLP1 files isn't loaded: the informations can then be
+// displayed, but not used to convert the mip levels.
+tInternalBLPInfos* blp_process_header(const char* buffer, size_t size, bool bHeaderOnly);
+
+// Minimum number of bytes of a mip level of the given dimensions (0 if unknown)
+size_t blp_mip_level_size(tInternalBLPInfos* pBLPInfos, unsigned int width, unsigned int height);
+
 #endif
@@ -0,0 +1,484 @@
+#include "blp.h"
+#include "blp_internal.h"
+
+// The internals of the JPEG decoder of stb_image are used to parse the header shared by all the
+// mip levels only once
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+
+// The state of the decoder once the tables of the shared header are loaded
+struct tBLPJPEGTables
+{
+    stbi__jpeg  jpeg;
+    uint32_t    resumeOffset;   // Where the parsing of the header stopped (at the frame header, if any)
+};
+
+
+// A JPEG stream made of the end of the shared header (after the tables), followed by the data of
+// one mip level, read by stb_image without concatenating them
+struct tJPEGStream
+{
+    const uint8_t*  pHeader;
+    uint32_t        headerSize;
+    const uint8_t*  pData;
+    uint32_t        size;
+    uint32_t        position;
+};
+
+
+static int blp_jpeg_read(void* user, char* data, int size)
+{
+    auto* pStream = static_cast<tJPEGStream*>(user);
+
+    int nbRead = 0;
+
+    if ((pStream->position < pStream->headerSize) && (size > 0))
+    {
+        uint32_t count = std::min(uint32_t(size), pStream->headerSize - pStream->position);
+        memcpy(data, pStream->pHeader + pStream->position, count);
+
+        pStream->position += count;
+        data += count;
+        size -= count;
+        nbRead += count;
+    }
+
+    uint32_t total = pStream->headerSize + pStream->size;
+    if ((pStream->position < total) && (size > 0))
+    {
+        uint32_t count = std::min(uint32_t(size), total - pStream->position);
+        memcpy(data, pStream->pData + (pStream->position - pStream->headerSize), count);
+
+        pStream->position += count;
+        nbRead += count;
+    }
+
+    return nbRead;
+}
+
+
+static void blp_jpeg_skip(void* user, int n)
+{
+    auto* pStream = static_cast<tJPEGStream*>(user);
+
+    uint32_t total = pStream->headerSize + pStream->size;
+    pStream->position = std::min(total, pStream->position + uint32_t(std::max(n, 0)));
+}
+
+
+static int blp_jpeg_eof(void* user)
+{
+    auto* pStream = static_cast<tJPEGStream*>(user);
+
+    return (pStream->position >= pStream->headerSize + pStream->size) ? 1 : 0;
+}
+
+
+tBLPJPEGTables* blp_jpeg_parse_header(const uint8_t* pHeader, uint32_t size)
+{
+    stbi__context context;
+    stbi__start_mem(&context, pHeader, int(size));
+
+    auto* pTables = new tBLPJPEGTables();
+    stbi__jpeg* z = &pTables->jpeg;
+
+    z->s = &context;
+    stbi__setup_jpeg(z);
+
+    // Same as stbi__decode_jpeg_header(), but stops at the first marker that isn't a table (usually
+    // the frame header, which is part of the data of each mip level)
+    z->jfif = 0;
+    z->app14_color_transform = -1;
+    z->restart_interval = 0;
+    z->marker = STBI__MARKER_none;
+
+    // Without shared header, each mip level is a complete JPEG file
+    if ((size > 0) && !stbi__SOI(stbi__get_marker(z)))
+    {
+        delete pTables;
+        return nullptr;
+    }
+
+    while (true)
+    {
+        uint32_t position = uint32_t(context.img_buffer - context.img_buffer_original);
+        if (position >= size)
+        {
+            pTables->resumeOffset = size;
+            break;
+        }
+
+        int m = stbi__get_marker(z);
+
+        const bool bTable = (m == 0xC4) || (m == 0xDB) || (m == 0xDD) || (m == 0xFE) || ((m >= 0xE0) && (m <= 0xEF));
+        if (!bTable)
+        {
+            pTables->resumeOffset = position;
+            break;
+        }
+
+        if (!stbi__process_marker(z, m))
+        {
+            delete pTables;
+            return nullptr;
+        }
+    }
+
+    z->s = nullptr;
+    z->marker = STBI__MARKER_none;
+
+    return pTables;
+}
+
+
+void blp_jpeg_release(tBLPJPEGTables* pTables)
+{
+    delete pTables;
+}
+
+
+/******************************** SCALED IDCT *********************************/
+
+// The decoder being used by the scaled IDCT kernels of the current thread (stb_image doesn't give
+// them any context)
+static thread_local const stbi__jpeg* tpScaledJPEG = nullptr;
+
+
+// Cu * cos((2x + 1) * u * PI / 2N), Cu being 1/sqrt(2) for u = 0 and 1 otherwise
+template<int N>
+static const float* blp_jpeg_idct_table()
+{
+    struct tTable
+    {
+        float values[N * N];
+
+        tTable()
+        {
+            const double PI = 3.14159265358979323846;
+
+            for (int x = 0; x < N; ++x)
+            {
+                for (int u = 0; u < N; ++u)
+                    values[x * N + u] = float((u == 0 ? std::sqrt(0.5) : 1.0) * std::cos((2 * x + 1) * u * PI / (2 * N)));
+            }
+        }
+    };
+
+    static const tTable table;
+    return table.values;
+}
+
+
+// Replaces the 8x8 IDCT of stb_image: produces a block of (8 / SCALE)x(8 / SCALE) pixels from the
+// low frequencies only. stb_image gives the position of the block in the full-size plane of its
+// component, the pixels are written at the same position in a plane reduced by SCALE (which
+// starts at the same address and keeps the same stride).
+template<int SCALE>
+static void blp_jpeg_idct_scaled(stbi_uc* out, int out_stride, short data[64])
+{
+    const int N = 8 / SCALE;
+    const stbi__jpeg* z = tpScaledJPEG;
+
+    for (int k = 0; k < z->s->img_n; ++k)
+    {
+        stbi_uc* pPlane = z->img_comp[k].data;
+        if ((out < pPlane) || (out >= pPlane + ptrdiff_t(z->img_comp[k].w2) * z->img_comp[k].h2))
+            continue;
+
+        const ptrdiff_t offset = out - pPlane;
+        stbi_uc* pDst = pPlane + (offset / out_stride / SCALE) * out_stride + (offset % out_stride) / SCALE;
+
+        if (N == 1)
+        {
+            // Only the DC coefficient, rounded like the full IDCT
+            pDst[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+            return;
+        }
+
+        const float* pTable = blp_jpeg_idct_table<N>();
+
+        // Rows, then columns
+        float rows[N * N];
+        for (int v = 0; v < N; ++v)
+        {
+            for (int x = 0; x < N; ++x)
+            {
+                float sum = 0.0f;
+                for (int u = 0; u < N; ++u)
+                    sum += data[v * 8 + u] * pTable[x * N + u];
+                rows[v * N + x] = sum;
+            }
+        }
+
+        for (int y = 0; y < N; ++y)
+        {
+            for (int x = 0; x < N; ++x)
+            {
+                float sum = 0.0f;
+                for (int v = 0; v < N; ++v)
+                    sum += rows[v * N + x] * pTable[y * N + v];
+
+                pDst[y * out_stride + x] = stbi__clamp(int(std::floor(sum * 0.25f + 128.5f)));
+            }
+        }
+
+        return;
+    }
+}
+
+
+// Same as stbi__decode_jpeg_image(), but the SOI marker and the tables were already processed
+static bool blp_jpeg_decode_image(stbi__jpeg* z)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        z->img_comp[i].raw_data = nullptr;
+        z->img_comp[i].raw_coeff = nullptr;
+    }
+
+    int m = stbi__get_marker(z);
+    if (stbi__SOI(m))
+        m = stbi__get_marker(z);
+
+    while (!stbi__SOF(m))
+    {
+        if (!stbi__process_marker(z, m))
+            return false;
+
+        m = stbi__get_marker(z);
+        while (m == STBI__MARKER_none)
+        {
+            // Some files have extra padding after their blocks
+            if (stbi__at_eof(z->s))
+                return false;
+            m = stbi__get_marker(z);
+        }
+    }
+
+    z->progressive = stbi__SOF_progressive(m);
+    if (!stbi__process_frame_header(z, STBI__SCAN_load))
+        return false;
+
+    m = stbi__get_marker(z);
+    while (!stbi__EOI(m))
+    {
+        if (stbi__SOS(m))
+        {
+            if (!stbi__process_scan_header(z) || !stbi__parse_entropy_coded_data(z))
+                return false;
+
+            if (z->marker == STBI__MARKER_none)
+                z->marker = stbi__skip_jpeg_junk_at_end(z);
+
+            m = stbi__get_marker(z);
+            if (STBI__RESTART(m))
+                m = stbi__get_marker(z);
+        }
+        else if (stbi__DNL(m))
+        {
+            int Ld = stbi__get16be(z->s);
+            stbi__uint32 NL = stbi__get16be(z->s);
+            if ((Ld != 4) || (NL != z->s->img_y))
+                return false;
+            m = stbi__get_marker(z);
+        }
+        else
+        {
+            if (!stbi__process_marker(z, m))
+                return true;
+            m = stbi__get_marker(z);
+        }
+    }
+
+    if (z->progressive)
+        stbi__jpeg_finish(z);
+
+    return true;
+}
+
+
+// Same as the end of load_jpeg_image() for 4 channels, but the color conversion writes the pixels
+// directly in the rows of the target
+static bool blp_jpeg_write_target(stbi__jpeg* z, const tBLPTarget& target)
+{
+    const unsigned int width = z->s->img_x;
+    const int nbComponents = z->s->img_n;
+    const bool bRGB = (nbComponents == 3) && ((z->rgb == 3) || ((z->app14_color_transform == 0) && !z->jfif));
+
+    stbi__resample resamplers[4];
+    for (int k = 0; k < nbComponents; ++k)
+    {
+        stbi__resample* r = &resamplers[k];
+
+        // Line buffer big enough for upsampling off the edges with upsample factor of 4
+        z->img_comp[k].linebuf = static_cast<stbi_uc*>(stbi__malloc(width + 3));
+        if (!z->img_comp[k].linebuf)
+            return false;
+
+        r->hs      = z->img_h_max / z->img_comp[k].h;
+        r->vs      = z->img_v_max / z->img_comp[k].v;
+        r->ystep   = r->vs >> 1;
+        r->w_lores = (width + r->hs - 1) / r->hs;
+        r->ypos    = 0;
+        r->line0   = r->line1 = z->img_comp[k].data;
+
+        if      ((r->hs == 1) && (r->vs == 1)) r->resample = resample_row_1;
+        else if ((r->hs == 1) && (r->vs == 2)) r->resample = stbi__resample_row_v_2;
+        else if ((r->hs == 2) && (r->vs == 1)) r->resample = stbi__resample_row_h_2;
+        else if ((r->hs == 2) && (r->vs == 2)) r->resample = z->resample_row_hv_2_kernel;
+        else                                   r->resample = stbi__resample_row_generic;
+    }
+
+    // The formats with 4 bytes per pixel are written in place, RGB8 from a temporary row
+    const bool bDirect = (target.format != BLP_PIXEL_FORMAT_RGB8);
+    std::vector<uint8_t> row(bDirect ? 0 : size_t(width) * 4);
+
+    for (unsigned int y = 0; y < z->s->img_y; ++y)
+    {
+        uint8_t* pRow = target.pData + ptrdiff_t(y) * target.pitch;
+        uint8_t* pOut = (bDirect ? pRow : row.data());
+
+        stbi_uc* coutput[4] = { nullptr, nullptr, nullptr, nullptr };
+        for (int k = 0; k < nbComponents; ++k)
+        {
+            stbi__resample* r = &resamplers[k];
+            const bool bBottom = (r->ystep >= (r->vs >> 1));
+
+            coutput[k] = r->resample(z->img_comp[k].linebuf, bBottom ? r->line1 : r->line0,
+                                     bBottom ? r->line0 : r->line1, r->w_lores, r->hs);
+
+            if (++r->ystep >= r->vs)
+            {
+                r->ystep = 0;
+                r->line0 = r->line1;
+                if (++r->ypos < z->img_comp[k].y)
+                    r->line1 += z->img_comp[k].w2;
+            }
+        }
+
+        if (bRGB)
+        {
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                const uint8_t pixel[4] = { coutput[0][i], coutput[1][i], coutput[2][i], 255 };
+                memcpy(pOut + i * 4, pixel, 4);
+            }
+        }
+        else if ((nbComponents == 4) && (z->app14_color_transform == 0))
+        {
+            // CMYK
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                const stbi_uc m = coutput[3][i];
+                const uint8_t pixel[4] = { stbi__blinn_8x8(coutput[0][i], m), stbi__blinn_8x8(coutput[1][i], m),
+                                           stbi__blinn_8x8(coutput[2][i], m), 255 };
+                memcpy(pOut + i * 4, pixel, 4);
+            }
+        }
+        else if (nbComponents >= 3)
+        {
+            z->YCbCr_to_RGB_kernel(pOut, coutput[0], coutput[1], coutput[2], width, 4);
+
+            // YCCK
+            if ((nbComponents == 4) && (z->app14_color_transform == 2))
+            {
+                for (unsigned int i = 0; i < width; ++i)
+                {
+                    const stbi_uc m = coutput[3][i];
+                    pOut[i * 4]     = stbi__blinn_8x8(255 - pOut[i * 4], m);
+                    pOut[i * 4 + 1] = stbi__blinn_8x8(255 - pOut[i * 4 + 1], m);
+                    pOut[i * 4 + 2] = stbi__blinn_8x8(255 - pOut[i * 4 + 2], m);
+                }
+            }
+        }
+        else
+        {
+            // Grayscale
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                const uint8_t pixel[4] = { coutput[0][i], coutput[0][i], coutput[0][i], 255 };
+                memcpy(pOut + i * 4, pixel, 4);
+            }
+        }
+
+        // The color conversion produced BGRA pixels (the JPEG data of the BLP files is stored in BGR
+        // order), and opaque pixels are already premultiplied
+        if (target.format != BLP_PIXEL_FORMAT_BGRA8)
+        {
+            // Swap the R and B channels
+            blp_convert_pixels(pOut, width, pOut, BLP_PIXEL_FORMAT_BGRA8);
+
+            if (target.format == BLP_PIXEL_FORMAT_RGB8)
+                blp_convert_pixels(pOut, width, pRow, BLP_PIXEL_FORMAT_RGB8);
+        }
+    }
+
+    return true;
+}
+
+
+bool blp1_decode_jpeg(const tBLPJPEGTables* pTables, const uint8_t* pHeader, uint32_t headerSize,
+                      const uint8_t* pSrc, uint32_t size, unsigned int width, unsigned int height,
+                      unsigned int scale, const tBLPTarget& target)
+{
+    tJPEGStream stream;
+    stream.pHeader    = pHeader + pTables->resumeOffset;
+    stream.headerSize = headerSize - pTables->resumeOffset;
+    stream.pData      = pSrc;
+    stream.size       = size;
+    stream.position   = 0;
+
+    stbi_io_callbacks callbacks = { blp_jpeg_read, blp_jpeg_skip, blp_jpeg_eof };
+
+    stbi__context context;
+    stbi__start_callbacks(&context, &callbacks, &stream);
+
+    // The decoder starts from the state reached at the end of the tables (too big for the stack)
+    auto* z = new stbi__jpeg(pTables->jpeg);
+    z->s = &context;
+    z->s->img_n = 0;
+
+    switch (scale)
+    {
+        case 2: z->idct_block_kernel = blp_jpeg_idct_scaled<2>; break;
+        case 4: z->idct_block_kernel = blp_jpeg_idct_scaled<4>; break;
+        case 8: z->idct_block_kernel = blp_jpeg_idct_scaled<8>; break;
+        default: break;
+    }
+
+    tpScaledJPEG = z;
+
+    bool bSuccess = blp_jpeg_decode_image(z);
+
+    tpScaledJPEG = nullptr;
+
+    // The callers expect the dimensions of the mip level given in the BLP header
+    bSuccess = bSuccess && (z->s->img_x == width) && (z->s->img_y == height);
+
+    if (bSuccess && (scale > 1))
+    {
+        // The color conversion and the upsampling only see the reduced planes
+        z->s->img_x = (z->s->img_x + scale - 1) / scale;
+        z->s->img_y = (z->s->img_y + scale - 1) / scale;
+
+        for (int k = 0; k < z->s->img_n; ++k)
+        {
+            z->img_comp[k].x = (z->img_comp[k].x + scale - 1) / scale;
+            z->img_comp[k].y = (z->img_comp[k].y + scale - 1) / scale;
+        }
+    }
+
+    if (bSuccess)
+        bSuccess = blp_jpeg_write_target(z, target);
+
+    stbi__cleanup_jpeg(z);
+    delete z;
+
+    return bSuccess;
+}
@@ -0,0 +1,461 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// The pixels are filtered as floats: the colors converted to linear values (if they are sRGB) and
+// multiplied by the alpha (if the colors are weighted by it), then the rows of the source level
+// are filtered horizontally, and the resulting rows vertically.
+
+
+/*********************************** WEIGHTS **********************************/
+
+static const double PI = 3.14159265358979323846;
+
+
+// Radius of the filters, in destination pixels
+static double blp_mip_filter_radius(tBLPMipFilter filter)
+{
+    switch (filter)
+    {
+        case BLP_MIP_FILTER_TRIANGLE:   return 1.0;
+        case BLP_MIP_FILTER_KAISER:     return 3.0;
+        default:                        return 0.5;
+    }
+}
+
+
+// Modified Bessel function of the first kind and of order 0 (for the Kaiser window)
+static double blp_bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (unsigned int k = 1; k < 32; ++k)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+
+// Value of the triangle and Kaiser filters at 'x' destination pixels from the center
+static double blp_mip_filter_value(tBLPMipFilter filter, double x)
+{
+    x = fabs(x);
+
+    if (filter == BLP_MIP_FILTER_TRIANGLE)
+        return std::max(1.0 - x, 0.0);
+
+    static const double ALPHA = 4.0;
+    const double radius = blp_mip_filter_radius(filter);
+
+    if (x >= radius)
+        return 0.0;
+
+    const double sinc = (x < 1e-6 ? 1.0 : sin(PI * x) / (PI * x));
+    const double t = x / radius;
+
+    return sinc * blp_bessel_i0(ALPHA * sqrt(1.0 - t * t)) / blp_bessel_i0(ALPHA);
+}
+
+
+static void blp_mip_weights(tBLPMipFilter filter, unsigned int srcSize, unsigned int dstSize,
+                            tBLPMipWeights& weights)
+{
+    const double scale = double(srcSize) / dstSize;
+    const double support = blp_mip_filter_radius(filter) * scale;
+
+    const unsigned int maxTaps = std::min(unsigned(ceil(support * 2.0)) + 1, srcSize);
+    std::vector<double> taps(size_t(dstSize) * maxTaps, 0.0);
+
+    weights.firsts.resize(dstSize);
+    weights.nbTaps = 1;
+
+    for (unsigned int i = 0; i < dstSize; ++i)
+    {
+        const double center = (i + 0.5) * scale;
+        const int start = int(floor(center - support));
+        const int end = int(ceil(center + support));
+
+        // The pixels beyond the edges are replaced by the ones on the edges
+        const unsigned int first = unsigned(std::min(std::max(start, 0), int(srcSize) - 1));
+        weights.firsts[i] = first;
+
+        double* pTaps = &taps[size_t(i) * maxTaps];
+        double total = 0.0;
+
+        for (int p = start; p < end; ++p)
+        {
+            // The box filter uses the part of the source pixel covered by the destination one
+            double weight;
+            if (filter == BLP_MIP_FILTER_BOX)
+                weight = std::max(std::min(p + 1.0, center + support) - std::max(double(p), center - support), 0.0);
+            else
+                weight = blp_mip_filter_value(filter, (p + 0.5 - center) / scale);
+
+            const unsigned int clamped = unsigned(std::min(std::max(p, 0), int(srcSize) - 1));
+            pTaps[clamped - first] += weight;
+            total += weight;
+        }
+
+        for (unsigned int t = 0; t < maxTaps; ++t)
+        {
+            pTaps[t] /= total;
+            if (pTaps[t] != 0.0)
+                weights.nbTaps = std::max(weights.nbTaps, t + 1);
+        }
+    }
+
+    // Only keep the taps used by at least one destination pixel. Near the end, the first source
+    // pixel is moved back so that all the taps stay in the source level (with a weight of 0).
+    weights.weights.assign(size_t(dstSize) * weights.nbTaps, 0.0f);
+
+    for (unsigned int i = 0; i < dstSize; ++i)
+    {
+        const unsigned int shift = std::max(weights.firsts[i] + weights.nbTaps, srcSize) - srcSize;
+        weights.firsts[i] -= shift;
+
+        for (unsigned int t = 0; t + shift < weights.nbTaps; ++t)
+            weights.weights[size_t(i) * weights.nbTaps + t + shift] = float(taps[size_t(i) * maxTaps + t]);
+    }
+}
+
+
+void blp_mip_prepare(tBLPMipFilter filter, tBLPMipLevel& level)
+{
+    blp_mip_weights(filter, level.srcWidth, level.dstWidth, level.horizontal);
+    blp_mip_weights(filter, level.srcHeight, level.dstHeight, level.vertical);
+}
+
+
+/*********************************** PIXELS ***********************************/
+
+struct tBLPMipTables
+{
+    float   toLinear[256];      // sRGB values to linear ones
+    float   toUnit[256];        // Values divided by 255
+    uint8_t toSRGB[4096];       // Linear values (on 12 bits) to sRGB ones
+};
+
+
+static tBLPMipTables blp_mip_build_tables()
+{
+    tBLPMipTables tables;
+
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+        const double value = i / 255.0;
+        tables.toLinear[i] = float(value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+        tables.toUnit[i] = float(value);
+    }
+
+    for (unsigned int i = 0; i < 4096; ++i)
+    {
+        const double value = i / 4095.0;
+        const double srgb = (value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055);
+        tables.toSRGB[i] = uint8_t(srgb * 255.0 + 0.5);
+    }
+
+    return tables;
+}
+
+
+static const tBLPMipTables& blp_mip_tables()
+{
+    static const tBLPMipTables tables = blp_mip_build_tables();
+    return tables;
+}
+
+
+// A row of the source level as floats, with the colors multiplied by the alpha if needed
+static void blp_mip_load_row(const tBLPMipLevel& level, const uint8_t* pSrc, float* pDst)
+{
+    const tBLPMipTables& tables = blp_mip_tables();
+    const float* pColors = (level.bSRGB ? tables.toLinear : tables.toUnit);
+
+    for (unsigned int x = 0; x < level.srcWidth; ++x, pSrc += 4, pDst += 4)
+    {
+        const float alpha = tables.toUnit[pSrc[3]];
+        const float factor = (level.bAlphaWeighting ? alpha : 1.0f);
+
+#if BLP_USE_SSE2
+        const __m128 colors = _mm_setr_ps(pColors[pSrc[0]], pColors[pSrc[1]], pColors[pSrc[2]], 1.0f);
+        _mm_storeu_ps(pDst, _mm_mul_ps(colors, _mm_setr_ps(factor, factor, factor, alpha)));
+#else
+        pDst[0] = pColors[pSrc[0]] * factor;
+        pDst[1] = pColors[pSrc[1]] * factor;
+        pDst[2] = pColors[pSrc[2]] * factor;
+        pDst[3] = alpha;
+#endif
+    }
+}
+
+
+// Converts a filtered row back to RGBA pixels
+static void blp_mip_store_row(const tBLPMipLevel& level, const float* pSrc, uint8_t* pDst)
+{
+    const tBLPMipTables& tables = blp_mip_tables();
+    const float scale = (level.bSRGB ? 4095.0f : 255.0f);
+
+    for (unsigned int x = 0; x < level.dstWidth; ++x, pSrc += 4, pDst += 4)
+    {
+        // Where the alpha is 0, so are the weighted colors: they end up black
+        const float alpha = std::min(std::max(pSrc[3], 0.0f), 1.0f);
+        const float factor = (level.bAlphaWeighting && (alpha > 0.0f) ? 1.0f / alpha : 1.0f);
+
+        int values[4];
+
+#if BLP_USE_SSE2
+        __m128 pixel = _mm_mul_ps(_mm_loadu_ps(pSrc), _mm_setr_ps(factor, factor, factor, 0.0f));
+        pixel = _mm_min_ps(_mm_max_ps(pixel, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        pixel = _mm_add_ps(_mm_mul_ps(pixel, _mm_set1_ps(scale)), _mm_setr_ps(0.0f, 0.0f, 0.0f, alpha * 255.0f));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_cvtps_epi32(pixel));
+#else
+        for (unsigned int c = 0; c < 3; ++c)
+            values[c] = int(std::min(std::max(pSrc[c] * factor, 0.0f), 1.0f) * scale + 0.5f);
+        values[3] = int(alpha * 255.0f + 0.5f);
+#endif
+
+        for (unsigned int c = 0; c < 3; ++c)
+            pDst[c] = (level.bSRGB ? tables.toSRGB[values[c]] : uint8_t(values[c]));
+        pDst[3] = uint8_t(values[3]);
+    }
+}
+
+
+/*********************************** SCALAR ***********************************/
+
+// Horizontal pass: a row of the source level into 'dstWidth' pixels
+static void blp_mip_filter_row_scalar(const float* pSrc, const tBLPMipWeights& weights, unsigned int dstWidth,
+                                      float* pDst)
+{
+    for (unsigned int x = 0; x < dstWidth; ++x)
+    {
+        const float* pPixels = pSrc + weights.firsts[x] * 4;
+        const float* pWeights = &weights.weights[size_t(x) * weights.nbTaps];
+
+        float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+        for (unsigned int t = 0; t < weights.nbTaps; ++t)
+        {
+            for (unsigned int c = 0; c < 4; ++c)
+                sum[c] += pPixels[t * 4 + c] * pWeights[t];
+        }
+
+        for (unsigned int c = 0; c < 4; ++c)
+            pDst[x * 4 + c] = sum[c];
+    }
+}
+
+
+// Vertical pass: 'count' values of the rows produced by the horizontal pass
+static void blp_mip_filter_column_scalar(const float* const* pRows, const float* pWeights, unsigned int nbTaps,
+                                         unsigned int count, float* pDst)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        float sum = 0.0f;
+        for (unsigned int t = 0; t < nbTaps; ++t)
+            sum += pRows[t][i] * pWeights[t];
+
+        pDst[i] = sum;
+    }
+}
+
+
+/************************************ SSE2 ************************************/
+
+#if BLP_USE_SSE2
+
+// One pixel per register
+static void blp_mip_filter_row_sse2(const float* pSrc, const tBLPMipWeights& weights, unsigned int dstWidth,
+                                    float* pDst)
+{
+    for (unsigned int x = 0; x < dstWidth; ++x)
+    {
+        const float* pPixels = pSrc + weights.firsts[x] * 4;
+        const float* pWeights = &weights.weights[size_t(x) * weights.nbTaps];
+
+        __m128 sum = _mm_setzero_ps();
+
+        for (unsigned int t = 0; t < weights.nbTaps; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pPixels + t * 4), _mm_set1_ps(pWeights[t])));
+
+        _mm_storeu_ps(pDst + x * 4, sum);
+    }
+}
+
+
+static void blp_mip_filter_column_sse2(const float* const* pRows, const float* pWeights, unsigned int nbTaps,
+                                       unsigned int count, float* pDst)
+{
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+
+        for (unsigned int t = 0; t < nbTaps; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pRows[t] + i), _mm_set1_ps(pWeights[t])));
+
+        _mm_storeu_ps(pDst + i, sum);
+    }
+
+    // The rows always contain whole pixels (4 values), so nothing should be left
+    if (i < count)
+        blp_mip_filter_column_scalar(pRows, pWeights, nbTaps, count - i, pDst + i);
+}
+
+#endif
+
+
+/************************************ AVX2 ************************************/
+
+#if BLP_USE_AVX2
+
+// Two pixels per register, each one with its own weights
+BLP_TARGET_AVX2 static void blp_mip_filter_row_avx2(const float* pSrc, const tBLPMipWeights& weights,
+                                                    unsigned int dstWidth, float* pDst)
+{
+    unsigned int x = 0;
+
+    for (; x + 2 <= dstWidth; x += 2)
+    {
+        const float* pPixels0 = pSrc + weights.firsts[x] * 4;
+        const float* pPixels1 = pSrc + weights.firsts[x + 1] * 4;
+        const float* pWeights0 = &weights.weights[size_t(x) * weights.nbTaps];
+        const float* pWeights1 = pWeights0 + weights.nbTaps;
+
+        __m256 sum = _mm256_setzero_ps();
+
+        for (unsigned int t = 0; t < weights.nbTaps; ++t)
+        {
+            const __m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(pPixels0 + t * 4)),
+                                                       _mm_loadu_ps(pPixels1 + t * 4), 1);
+            const __m256 factors = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(pWeights0[t])),
+                                                        _mm_set1_ps(pWeights1[t]), 1);
+
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(pixels, factors));
+        }
+
+        _mm256_storeu_ps(pDst + x * 4, sum);
+    }
+
+    if (x < dstWidth)
+    {
+        const float* pPixels = pSrc + weights.firsts[x] * 4;
+        const float* pWeights = &weights.weights[size_t(x) * weights.nbTaps];
+
+        __m128 sum = _mm_setzero_ps();
+
+        for (unsigned int t = 0; t < weights.nbTaps; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pPixels + t * 4), _mm_set1_ps(pWeights[t])));
+
+        _mm_storeu_ps(pDst + x * 4, sum);
+    }
+}
+
+
+BLP_TARGET_AVX2 static void blp_mip_filter_column_avx2(const float* const* pRows, const float* pWeights,
+                                                       unsigned int nbTaps, unsigned int count, float* pDst)
+{
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 sum = _mm256_setzero_ps();
+
+        for (unsigned int t = 0; t < nbTaps; ++t)
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(pRows[t] + i), _mm256_set1_ps(pWeights[t])));
+
+        _mm256_storeu_ps(pDst + i, sum);
+    }
+
+    // At most one pixel left
+    for (; i < count; i += 4)
+    {
+        __m128 sum = _mm_setzero_ps();
+
+        for (unsigned int t = 0; t < nbTaps; ++t)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(pRows[t] + i), _mm_set1_ps(pWeights[t])));
+
+        _mm_storeu_ps(pDst + i, sum);
+    }
+}
+
+#endif
+
+
+/********************************** DISPATCH **********************************/
+
+typedef void (*tMipRowFilter)(const float* pSrc, const tBLPMipWeights& weights, unsigned int dstWidth, float* pDst);
+typedef void (*tMipColumnFilter)(const float* const* pRows, const float* pWeights, unsigned int nbTaps,
+                                 unsigned int count, float* pDst);
+
+
+void blp_mip_filter_rows(const tBLPMipLevel& level, unsigned int firstRow, unsigned int nbRows)
+{
+    tMipRowFilter filterRow = blp_mip_filter_row_scalar;
+    tMipColumnFilter filterColumn = blp_mip_filter_column_scalar;
+
+    const tBLPCpuLevel cpuLevel = blp_cpu_level();
+
+#if BLP_USE_SSE2
+    if (cpuLevel >= BLP_CPU_SSE2)
+    {
+        filterRow = blp_mip_filter_row_sse2;
+        filterColumn = blp_mip_filter_column_sse2;
+    }
+#endif
+
+#if BLP_USE_AVX2
+    if (cpuLevel >= BLP_CPU_AVX2)
+    {
+        filterRow = blp_mip_filter_row_avx2;
+        filterColumn = blp_mip_filter_column_avx2;
+    }
+#endif
+
+    const unsigned int lastRow = std::min(firstRow + nbRows, level.dstHeight);
+    if (firstRow >= lastRow)
+        return;
+
+    const tBLPMipWeights& vertical = level.vertical;
+
+    // Horizontal pass on the source rows used by the band (the ones at its edges are also
+    // filtered by the neighbour bands)
+    const unsigned int srcFirst = vertical.firsts[firstRow];
+    const unsigned int srcEnd = vertical.firsts[lastRow - 1] + vertical.nbTaps;
+    const size_t rowSize = size_t(level.dstWidth) * 4;
+
+    std::vector<float> source(size_t(level.srcWidth) * 4);
+    std::vector<float> rows(rowSize * (srcEnd - srcFirst));
+
+    for (unsigned int y = srcFirst; y < srcEnd; ++y)
+    {
+        blp_mip_load_row(level, level.pSrc + size_t(y) * level.srcWidth * 4, source.data());
+        filterRow(source.data(), level.horizontal, level.dstWidth, &rows[(y - srcFirst) * rowSize]);
+    }
+
+    std::vector<const float*> pRows(vertical.nbTaps);
+    std::vector<float> filtered(rowSize);
+
+    for (unsigned int y = firstRow; y < lastRow; ++y)
+    {
+        for (unsigned int t = 0; t < vertical.nbTaps; ++t)
+            pRows[t] = &rows[(vertical.firsts[y] - srcFirst + t) * rowSize];
+
+        filterColumn(pRows.data(), &vertical.weights[size_t(y) * vertical.nbTaps], vertical.nbTaps,
+                     unsigned(rowSize), filtered.data());
+
+        blp_mip_store_row(level, filtered.data(), level.pDst + y * rowSize);
+    }
+}
@@ -0,0 +1,337 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#include <cstring>
+#include <vector>
+
+
+// The palette, converted once in the output channel order. When the alpha comes from a separate
+// plane, the alpha of the entries is left at 0 so the plane can simply be OR'ed in.
+static void blp_prepare_palette(const tBGRAPixel* pPalette, tBLPPaletteAlpha alpha, bool bSwapRB, bool bPremultiply,
+                                uint32_t* pDst)
+{
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+        const tBGRAPixel& entry = pPalette[i];
+
+        uint8_t a;
+        switch (alpha)
+        {
+            case BLP_PALETTE_ALPHA_NONE:        a = 0xFF; break;
+            case BLP_PALETTE_ALPHA_INVERTED:    a = 0xFF - entry.a; break;
+            default:                            a = 0x00; break;
+        }
+
+        const uint8_t pixel[4] = { bSwapRB ? entry.b : entry.r, entry.g, bSwapRB ? entry.r : entry.b, a };
+        memcpy(&pDst[i], pixel, 4);
+    }
+
+    // When the alpha comes from the palette, the entries can be premultiplied once and for all
+    if (bPremultiply)
+    {
+        uint8_t* pEntries = reinterpret_cast<uint8_t*>(pDst);
+        blp_convert_pixels(pEntries, 256, pEntries, BLP_PIXEL_FORMAT_RGBA8_PREMULTIPLIED);
+    }
+}
+
+
+// Alpha value of a pixel from a plane of 1-, 4- or 8-bits values
+static inline uint8_t blp_plane_alpha(const uint8_t* pAlpha, unsigned int alphaDepth, size_t pixel)
+{
+    switch (alphaDepth)
+    {
+        case 1:     return ((pAlpha[pixel >> 3] >> (pixel & 0x7)) & 0x1) ? 0xFF : 0x00;
+        case 4:     { uint8_t a = (pAlpha[pixel >> 1] >> ((pixel & 0x1) * 4)) & 0xF; return (a << 4) | a; }
+        case 8:     return pAlpha[pixel];
+        default:    return 0xFF;
+    }
+}
+
+
+// Decodes the pixels [x, width) of a row, 'pixel' being the index of the first one in the image
+static void blp_decode_paletted_scalar(const uint8_t* pIndices, const uint8_t* pAlpha, unsigned int alphaDepth,
+                                       const uint32_t* pPalette, size_t pixel, unsigned int count, uint8_t* pDst)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        memcpy(pDst + i * 4, &pPalette[pIndices[i]], 4);
+
+        if (alphaDepth != 0)
+            pDst[i * 4 + 3] = blp_plane_alpha(pAlpha, alphaDepth, pixel + i);
+    }
+}
+
+
+/************************************ SSE2 ************************************/
+
+#if BLP_USE_SSE2
+
+// Returns the alpha values of 16 pixels, starting at a byte boundary of the plane
+static inline __m128i blp_plane_alphas_sse2(const uint8_t* pAlpha, unsigned int alphaDepth)
+{
+    switch (alphaDepth)
+    {
+        case 1:
+        {
+            // Replicate each byte 8 times, and test one bit in each copy
+            uint16_t packed;
+            memcpy(&packed, pAlpha, 2);
+
+            __m128i bits = _mm_cvtsi32_si128(packed);
+            bits = _mm_unpacklo_epi8(bits, bits);
+            bits = _mm_unpacklo_epi16(bits, bits);
+            bits = _mm_unpacklo_epi32(bits, bits);
+
+            const __m128i masks = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128));
+            return _mm_cmpeq_epi8(_mm_and_si128(bits, masks), masks);
+        }
+
+        case 4:
+        {
+            // Expand the 4-bits values to 8 bits: (x << 4) | x
+            const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pAlpha));
+            const __m128i low = _mm_and_si128(packed, _mm_set1_epi8(0x0F));
+            const __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), _mm_set1_epi8(0x0F));
+            const __m128i nibbles = _mm_unpacklo_epi8(low, high);
+
+            return _mm_or_si128(nibbles, _mm_slli_epi16(nibbles, 4));
+        }
+
+        default:
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(pAlpha));
+    }
+}
+
+
+template<bool ALPHA>
+static void blp_decode_paletted_row_sse2(const uint8_t* pIndices, const uint8_t* pAlpha, unsigned int alphaDepth,
+                                         const uint32_t* pPalette, size_t pixel, unsigned int width, uint8_t* pDst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const uint8_t* pChunk = pIndices + x;
+
+        __m128i pixels[4];
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            pixels[i] = _mm_setr_epi32(int(pPalette[pChunk[4 * i]]), int(pPalette[pChunk[4 * i + 1]]),
+                                       int(pPalette[pChunk[4 * i + 2]]), int(pPalette[pChunk[4 * i + 3]]));
+        }
+
+        if (ALPHA)
+        {
+            // Move the alpha values in the highest byte of each pixel
+            const __m128i alphas = blp_plane_alphas_sse2(pAlpha + (pixel + x) * alphaDepth / 8, alphaDepth);
+
+            const __m128i low = _mm_unpacklo_epi8(zero, alphas);
+            const __m128i high = _mm_unpackhi_epi8(zero, alphas);
+
+            pixels[0] = _mm_or_si128(pixels[0], _mm_unpacklo_epi16(zero, low));
+            pixels[1] = _mm_or_si128(pixels[1], _mm_unpackhi_epi16(zero, low));
+            pixels[2] = _mm_or_si128(pixels[2], _mm_unpacklo_epi16(zero, high));
+            pixels[3] = _mm_or_si128(pixels[3], _mm_unpackhi_epi16(zero, high));
+        }
+
+        for (unsigned int i = 0; i < 4; ++i)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + (x + 4 * i) * 4), pixels[i]);
+    }
+
+    blp_decode_paletted_scalar(pIndices + x, pAlpha, alphaDepth, pPalette, pixel + x, width - x, pDst + x * 4);
+}
+
+#endif
+
+
+/************************************ AVX2 ************************************/
+
+#if BLP_USE_AVX2
+
+// Returns the alpha values of 8 pixels in the highest byte of each lane, starting at a byte
+// boundary of the plane
+BLP_TARGET_AVX2 static inline __m256i blp_plane_alphas_avx2(const uint8_t* pAlpha, unsigned int alphaDepth)
+{
+    switch (alphaDepth)
+    {
+        case 1:
+        {
+            const __m256i masks = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+            const __m256i bits = _mm256_and_si256(_mm256_set1_epi32(pAlpha[0]), masks);
+            return _mm256_slli_epi32(_mm256_cmpeq_epi32(bits, masks), 24);
+        }
+
+        case 4:
+        {
+            uint32_t packed;
+            memcpy(&packed, pAlpha, 4);
+
+            const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+            __m256i alphas = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(packed)), shifts),
+                                              _mm256_set1_epi32(0xF));
+            alphas = _mm256_or_si256(alphas, _mm256_slli_epi32(alphas, 4));
+            return _mm256_slli_epi32(alphas, 24);
+        }
+
+        default:
+            return _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pAlpha))), 24);
+    }
+}
+
+
+template<bool ALPHA>
+BLP_TARGET_AVX2 static void blp_decode_paletted_row_avx2(const uint8_t* pIndices, const uint8_t* pAlpha, unsigned int alphaDepth,
+                                                         const uint32_t* pPalette, size_t pixel, unsigned int width, uint8_t* pDst)
+{
+    const int* pTable = reinterpret_cast<const int*>(pPalette);
+
+    unsigned int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pIndices + x)));
+        __m256i pixels = _mm256_i32gather_epi32(pTable, indices, 4);
+
+        if (ALPHA)
+            pixels = _mm256_or_si256(pixels, blp_plane_alphas_avx2(pAlpha + (pixel + x) * alphaDepth / 8, alphaDepth));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + x * 4), pixels);
+    }
+
+    blp_decode_paletted_scalar(pIndices + x, pAlpha, alphaDepth, pPalette, pixel + x, width - x, pDst + x * 4);
+}
+
+#endif
+
+
+// Decodes a row with the fastest path available
+static void blp_decode_paletted_row(const uint8_t* pIndices, const uint8_t* pAlpha, unsigned int alphaDepth,
+                                    const uint32_t* pPalette, size_t pixel, unsigned int width, uint8_t* pDst,
+                                    tBLPCpuLevel level)
+{
+    // The vectorized paths read the alpha plane from a byte boundary
+    const bool bAligned = (((pixel * alphaDepth) & 0x7) == 0);
+
+#if BLP_USE_AVX2
+    if ((level >= BLP_CPU_AVX2) && bAligned)
+    {
+        if (alphaDepth != 0)
+            blp_decode_paletted_row_avx2<true>(pIndices, pAlpha, alphaDepth, pPalette, pixel, width, pDst);
+        else
+            blp_decode_paletted_row_avx2<false>(pIndices, pAlpha, alphaDepth, pPalette, pixel, width, pDst);
+        return;
+    }
+#endif
+
+#if BLP_USE_SSE2
+    if ((level >= BLP_CPU_SSE2) && bAligned)
+    {
+        if (alphaDepth != 0)
+            blp_decode_paletted_row_sse2<true>(pIndices, pAlpha, alphaDepth, pPalette, pixel, width, pDst);
+        else
+            blp_decode_paletted_row_sse2<false>(pIndices, pAlpha, alphaDepth, pPalette, pixel, width, pDst);
+        return;
+    }
+#endif
+
+    blp_decode_paletted_scalar(pIndices, pAlpha, alphaDepth, pPalette, pixel, width, pDst);
+}
+
+
+void blp_decode_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tBLPPaletteAlpha alpha,
+                         unsigned int width, unsigned int height, const tBLPTarget& target)
+{
+    // Without alpha in the output, the alpha plane doesn't need to be read at all
+    const bool bRGB = (target.format == BLP_PIXEL_FORMAT_RGB8);
+    if (bRGB)
+        alpha = BLP_PALETTE_ALPHA_NONE;
+
+    const bool bPremultiplied = (target.format == BLP_PIXEL_FORMAT_RGBA8_PREMULTIPLIED);
+    const bool bPlane = (alpha >= BLP_PALETTE_ALPHA_PLANE_1);
+
+    uint32_t palette[256];
+    blp_prepare_palette(pPalette, alpha, (target.format == BLP_PIXEL_FORMAT_BGRA8), bPremultiplied && !bPlane, palette);
+
+    // The RGB rows are first decoded as RGBA
+    std::vector<uint8_t> row(bRGB ? size_t(width) * 4 : 0);
+
+    unsigned int alphaDepth = 0;
+    switch (alpha)
+    {
+        case BLP_PALETTE_ALPHA_PLANE_1: alphaDepth = 1; break;
+        case BLP_PALETTE_ALPHA_PLANE_4: alphaDepth = 4; break;
+        case BLP_PALETTE_ALPHA_PLANE_8: alphaDepth = 8; break;
+        default:                        break;
+    }
+
+    const uint8_t* pAlpha = pSrc + size_t(width) * height;
+    const tBLPCpuLevel level = blp_cpu_level();
+
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        const uint8_t* pIndices = pSrc + size_t(y) * width;
+        const size_t pixel = size_t(y) * width;
+        uint8_t* pRow = target.pData + ptrdiff_t(y) * target.pitch;
+        uint8_t* pDst = (bRGB ? row.data() : pRow);
+
+        blp_decode_paletted_row(pIndices, pAlpha, alphaDepth, palette, pixel, width, pDst, level);
+
+        if (bRGB)
+            blp_convert_pixels(pDst, width, pRow, BLP_PIXEL_FORMAT_RGB8);
+        else if (bPremultiplied && bPlane)
+            blp_convert_pixels(pRow, width, pRow, BLP_PIXEL_FORMAT_RGBA8_PREMULTIPLIED);
+    }
+}
+
+
+bool blp_extract_paletted(const uint8_t* pSrc, const tBGRAPixel* pPalette, tBLPPaletteAlpha alpha,
+                          unsigned int width, unsigned int height, uint8_t* pIndices, uint8_t* pColors)
+{
+    const bool bPlane = (alpha >= BLP_PALETTE_ALPHA_PLANE_1);
+
+    uint32_t palette[256];
+    blp_prepare_palette(pPalette, alpha, false, false, palette);
+    memcpy(pColors, palette, sizeof(palette));
+
+    const size_t nbPixels = size_t(width) * height;
+    memcpy(pIndices, pSrc, nbPixels);
+
+    if (!bPlane)
+        return true;
+
+    unsigned int alphaDepth = 8;
+    if (alpha == BLP_PALETTE_ALPHA_PLANE_1)
+        alphaDepth = 1;
+    else if (alpha == BLP_PALETTE_ALPHA_PLANE_4)
+        alphaDepth = 4;
+
+    // The alpha of each color is the one of the first pixel using it, the others must agree
+    const uint8_t* pAlpha = pSrc + nbPixels;
+    bool used[256] = { false };
+
+    for (size_t pixel = 0; pixel < nbPixels; ++pixel)
+    {
+        const uint8_t index = pSrc[pixel];
+        const uint8_t a = blp_plane_alpha(pAlpha, alphaDepth, pixel);
+
+        if (!used[index])
+        {
+            used[index] = true;
+            pColors[index * 4 + 3] = a;
+        }
+        else if (pColors[index * 4 + 3] != a)
+        {
+            return false;
+        }
+    }
+
+    // The unused colors stay opaque, so they don't lengthen a list of alpha values
+    for (unsigned int i = 0; i < 256; ++i)
+    {
+        if (!used[i])
+            pColors[i * 4 + 3] = 0xFF;
+    }
+
+    return true;
+}
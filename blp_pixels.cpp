@@ -0,0 +1,87 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#include <cstring>
+
+
+unsigned int blp_bytes_per_pixel(tBLPPixelFormat format)
+{
+    return (format == BLP_PIXEL_FORMAT_RGB8 ? 3 : 4);
+}
+
+
+// (c * a) / 255, rounded to the nearest (exact for all the 8-bits values)
+static inline uint8_t blp_premultiply(uint8_t c, uint8_t a)
+{
+    unsigned int t = c * a + 128;
+    return uint8_t((t + (t >> 8)) >> 8);
+}
+
+
+#if BLP_USE_SSE2
+
+// Premultiplies 2 RGBA pixels stored in 16-bits lanes
+static inline __m128i blp_premultiply_sse2(__m128i pixels)
+{
+    // The alpha of each pixel in all its lanes, except the alpha one which is multiplied by 255
+    __m128i alphas = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, 0xFF), 0xFF);
+    alphas = _mm_or_si128(_mm_and_si128(alphas, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0)),
+                          _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(pixels, alphas), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+#endif
+
+
+void blp_convert_pixels(const uint8_t* pSrc, unsigned int count, uint8_t* pDst, tBLPPixelFormat format)
+{
+    unsigned int i = 0;
+
+    switch (format)
+    {
+        case BLP_PIXEL_FORMAT_RGBA8:
+            memmove(pDst, pSrc, count * 4);
+            break;
+
+        case BLP_PIXEL_FORMAT_BGRA8:
+            for (; i < count; ++i)
+            {
+                const uint8_t pixel[4] = { pSrc[i * 4 + 2], pSrc[i * 4 + 1], pSrc[i * 4], pSrc[i * 4 + 3] };
+                memcpy(pDst + i * 4, pixel, 4);
+            }
+            break;
+
+        case BLP_PIXEL_FORMAT_RGB8:
+            for (; i < count; ++i)
+            {
+                const uint8_t pixel[3] = { pSrc[i * 4], pSrc[i * 4 + 1], pSrc[i * 4 + 2] };
+                memcpy(pDst + i * 3, pixel, 3);
+            }
+            break;
+
+        case BLP_PIXEL_FORMAT_RGBA8_PREMULTIPLIED:
+#if BLP_USE_SSE2
+            for (; i + 4 <= count; i += 4)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i * 4));
+
+                const __m128i low = blp_premultiply_sse2(_mm_unpacklo_epi8(pixels, zero));
+                const __m128i high = blp_premultiply_sse2(_mm_unpackhi_epi8(pixels, zero));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + i * 4), _mm_packus_epi16(low, high));
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                const uint8_t a = pSrc[i * 4 + 3];
+                const uint8_t pixel[4] = { blp_premultiply(pSrc[i * 4], a), blp_premultiply(pSrc[i * 4 + 1], a),
+                                           blp_premultiply(pSrc[i * 4 + 2], a), a };
+                memcpy(pDst + i * 4, pixel, 4);
+            }
+            break;
+    }
+}
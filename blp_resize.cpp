@@ -0,0 +1,288 @@
+#include "blp.h"
+#include "blp_internal.h"
+#include "blp_simd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+
+// Weights of the source pixels covered by each destination pixel, along one axis (14-bits fixed
+// point, summing to 1 << 14). Each destination pixel has 'nbTaps' weights, padded with zeroes.
+struct tBLPBoxWeights
+{
+    unsigned int            nbTaps;
+    std::vector<unsigned>   firsts;     // Index of the first source pixel
+    std::vector<int16_t>    weights;
+};
+
+
+static void blp_box_weights(unsigned int srcSize, unsigned int dstSize, tBLPBoxWeights& box)
+{
+    const double scale = double(srcSize) / dstSize;
+
+    box.nbTaps = unsigned(scale) + 2;
+    box.firsts.resize(dstSize);
+    box.weights.assign(size_t(dstSize) * box.nbTaps, 0);
+
+    for (unsigned int i = 0; i < dstSize; ++i)
+    {
+        const double start = i * scale;
+        const double end = std::min((i + 1) * scale, double(srcSize));
+
+        const unsigned int first = unsigned(start);
+        box.firsts[i] = first;
+
+        int16_t* pWeights = &box.weights[size_t(i) * box.nbTaps];
+        int total = 0;
+        unsigned int biggest = 0;
+
+        for (unsigned int t = 0; (t < box.nbTaps) && (first + t < end); ++t)
+        {
+            // Part of the source pixel covered by the destination one
+            const double coverage = std::min(end, first + t + 1.0) - std::max(start, double(first + t));
+
+            pWeights[t] = int16_t(coverage / scale * (1 << 14) + 0.5);
+            total += pWeights[t];
+
+            if (pWeights[t] > pWeights[biggest])
+                biggest = t;
+        }
+
+        // Compensate the rounding errors, so a plain color stays the same
+        pWeights[biggest] = int16_t(pWeights[biggest] + (1 << 14) - total);
+
+        // A zero weight marks the end of the list, so skip a first source pixel barely covered
+        if (pWeights[0] == 0)
+        {
+            std::copy(pWeights + 1, pWeights + box.nbTaps, pWeights);
+            pWeights[box.nbTaps - 1] = 0;
+            ++box.firsts[i];
+        }
+    }
+}
+
+
+// Horizontal pass: a row of 4-channels pixels into values scaled by 128
+static void blp_downscale_row(const uint8_t* pSrc, const tBLPBoxWeights& box, unsigned int dstWidth, int16_t* pDst)
+{
+    for (unsigned int x = 0; x < dstWidth; ++x)
+    {
+        const uint8_t* pPixels = pSrc + box.firsts[x] * 4;
+        const int16_t* pWeights = &box.weights[size_t(x) * box.nbTaps];
+
+#if BLP_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = _mm_setzero_si128();
+
+        for (unsigned int t = 0; (t < box.nbTaps) && (pWeights[t] != 0); ++t)
+        {
+            // One channel in the low half of each 32-bits lane
+            uint32_t packed;
+            memcpy(&packed, pPixels + t * 4, 4);
+
+            __m128i pixel = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(packed)), zero), zero);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pixel, _mm_set1_epi32(pWeights[t])));
+        }
+
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(64)), 7);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pDst + x * 4), _mm_packs_epi32(sum, sum));
+#else
+        int sum[4] = { 0, 0, 0, 0 };
+
+        for (unsigned int t = 0; (t < box.nbTaps) && (pWeights[t] != 0); ++t)
+        {
+            for (unsigned int c = 0; c < 4; ++c)
+                sum[c] += pPixels[t * 4 + c] * pWeights[t];
+        }
+
+        for (unsigned int c = 0; c < 4; ++c)
+            pDst[x * 4 + c] = int16_t((sum[c] + 64) >> 7);
+#endif
+    }
+}
+
+
+// Vertical pass: 'count' values of the rows produced by the horizontal pass into pixels
+static void blp_downscale_column(const int16_t* const* pRows, const int16_t* pWeights, unsigned int nbTaps,
+                                 unsigned int count, uint8_t* pDst)
+{
+    unsigned int i = 0;
+
+#if BLP_USE_SSE2
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i low = _mm_setzero_si128();
+        __m128i high = _mm_setzero_si128();
+
+        // Two rows at a time: (a * wa + b * wb) for each value
+        for (unsigned int t = 0; (t < nbTaps) && (pWeights[t] != 0); t += 2)
+        {
+            const bool bPair = (t + 1 < nbTaps) && (pWeights[t + 1] != 0);
+
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRows[t] + i));
+            const __m128i b = (bPair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRows[t + 1] + i))
+                                     : _mm_setzero_si128());
+            const __m128i weights = _mm_set1_epi32(int(uint16_t(pWeights[t])) |
+                                                   (bPair ? int(uint32_t(uint16_t(pWeights[t + 1])) << 16) : 0));
+
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+        }
+
+        const __m128i rounding = _mm_set1_epi32(1 << 20);
+        low = _mm_srai_epi32(_mm_add_epi32(low, rounding), 21);
+        high = _mm_srai_epi32(_mm_add_epi32(high, rounding), 21);
+
+        const __m128i values = _mm_packs_epi32(low, high);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(pDst + i), _mm_packus_epi16(values, values));
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        int sum = 0;
+        for (unsigned int t = 0; (t < nbTaps) && (pWeights[t] != 0); ++t)
+            sum += pRows[t][i] * pWeights[t];
+
+        pDst[i] = uint8_t(std::min(std::max((sum + (1 << 20)) >> 21, 0), 255));
+    }
+}
+
+
+bool blp_downscale(const uint8_t* pSrc, unsigned int srcWidth, unsigned int srcHeight,
+                   uint8_t* pDst, unsigned int dstWidth, unsigned int dstHeight)
+{
+    if ((dstWidth == 0) || (dstHeight == 0) || (dstWidth > srcWidth) || (dstHeight > srcHeight))
+        return false;
+
+    tBLPBoxWeights horizontal;
+    tBLPBoxWeights vertical;
+    blp_box_weights(srcWidth, dstWidth, horizontal);
+    blp_box_weights(srcHeight, dstHeight, vertical);
+
+    // Horizontal pass on all the rows first, each one being used by one or two destination rows
+    const size_t rowSize = size_t(dstWidth) * 4;
+    std::vector<int16_t> rows(rowSize * srcHeight);
+
+    for (unsigned int y = 0; y < srcHeight; ++y)
+        blp_downscale_row(pSrc + size_t(y) * srcWidth * 4, horizontal, dstWidth, &rows[y * rowSize]);
+
+    std::vector<const int16_t*> pRows(vertical.nbTaps);
+
+    for (unsigned int y = 0; y < dstHeight; ++y)
+    {
+        for (unsigned int t = 0; t < vertical.nbTaps; ++t)
+            pRows[t] = &rows[std::min(vertical.firsts[y] + t, srcHeight - 1) * rowSize];
+
+        blp_downscale_column(pRows.data(), &vertical.weights[size_t(y) * vertical.nbTaps], vertical.nbTaps,
+                             unsigned(rowSize), pDst + y * rowSize);
+    }
+
+    return true;
+}
+
+
+// Size of the thumbnail fitting in 'maxWidth' x 'maxHeight', and the mip level to downscale
+static unsigned int blp_thumbnail_size(tBLPInfos blpInfos, unsigned int maxWidth, unsigned int maxHeight,
+                                       unsigned int* pWidth, unsigned int* pHeight)
+{
+    // Size of the thumbnail: the image fitted in the box, keeping its aspect ratio
+    const unsigned int width = blp_width(blpInfos);
+    const unsigned int height = blp_height(blpInfos);
+
+    unsigned int dstWidth = width;
+    unsigned int dstHeight = height;
+
+    if ((width > maxWidth) || (height > maxHeight))
+    {
+        if (uint64_t(maxWidth) * height <= uint64_t(maxHeight) * width)
+        {
+            dstWidth = maxWidth;
+            dstHeight = unsigned(std::max<uint64_t>((uint64_t(height) * maxWidth + width / 2) / width, 1));
+        }
+        else
+        {
+            dstHeight = maxHeight;
+            dstWidth = unsigned(std::max<uint64_t>((uint64_t(width) * maxHeight + height / 2) / height, 1));
+        }
+    }
+
+    // The smallest mip level still big enough, so the biggest ones are usually never read
+    unsigned int mipLevel = 0;
+    while ((mipLevel + 1 < blp_nb_mip_levels(blpInfos)) && (blp_width(blpInfos, mipLevel + 1) >= dstWidth) &&
+           (blp_height(blpInfos, mipLevel + 1) >= dstHeight))
+    {
+        ++mipLevel;
+    }
+
+    *pWidth = dstWidth;
+    *pHeight = dstHeight;
+
+    return mipLevel;
+}
+
+
+unsigned int blp_thumbnail_mip_level(tBLPInfos blpInfos, unsigned int maxWidth, unsigned int maxHeight)
+{
+    unsigned int dstWidth;
+    unsigned int dstHeight;
+
+    return blp_thumbnail_size(blpInfos, std::max(maxWidth, 1u), std::max(maxHeight, 1u), &dstWidth, &dstHeight);
+}
+
+
+uint8_t* blp_convert_thumbnail(const char* buffer, tBLPInfos blpInfos, unsigned int maxWidth, unsigned int maxHeight,
+                               tBLPPixelFormat pixelFormat, unsigned int* pWidth, unsigned int* pHeight)
+{
+    if ((maxWidth == 0) || (maxHeight == 0))
+        return nullptr;
+
+    unsigned int dstWidth;
+    unsigned int dstHeight;
+    const unsigned int mipLevel = blp_thumbnail_size(blpInfos, maxWidth, maxHeight, &dstWidth, &dstHeight);
+
+    // The premultiplied pixels are averaged as is, the other formats are downscaled in RGBA
+    const tBLPPixelFormat decodeFormat = (pixelFormat == BLP_PIXEL_FORMAT_RGB8 ? BLP_PIXEL_FORMAT_RGBA8 : pixelFormat);
+
+    // The JPEG files can also skip a part of the work of the IDCT
+    uint8_t* pPixels = nullptr;
+    unsigned int srcWidth = 0;
+    unsigned int srcHeight = 0;
+
+    for (unsigned int scale = 8; !pPixels && (scale >= 1); scale /= 2)
+    {
+        if ((scale == 1) || (((blp_width(blpInfos, mipLevel) + scale - 1) / scale >= dstWidth) &&
+                             ((blp_height(blpInfos, mipLevel) + scale - 1) / scale >= dstHeight)))
+        {
+            pPixels = blp_convert_buffer_scaled(buffer, blpInfos, mipLevel, scale, decodeFormat, &srcWidth, &srcHeight);
+        }
+    }
+
+    if (!pPixels)
+        return nullptr;
+
+    // A mip level of the exact size doesn't need any resampling
+    if ((srcWidth != dstWidth) || (srcHeight != dstHeight))
+    {
+        uint8_t* pThumbnail = new uint8_t[size_t(dstWidth) * dstHeight * 4];
+        const bool bSuccess = blp_downscale(pPixels, srcWidth, srcHeight, pThumbnail, dstWidth, dstHeight);
+
+        delete[] pPixels;
+        pPixels = pThumbnail;
+
+        if (!bSuccess)
+        {
+            delete[] pPixels;
+            return nullptr;
+        }
+    }
+
+    if (decodeFormat != pixelFormat)
+        blp_convert_pixels(pPixels, dstWidth * dstHeight, pPixels, pixelFormat);
+
+    *pWidth = dstWidth;
+    *pHeight = dstHeight;
+
+    return pPixels;
+}
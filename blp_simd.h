@@ -0,0 +1,27 @@
+#ifndef _BLP_SIMD_H_
+#define _BLP_SIMD_H_
+
+// SSE2 is always available on x86-64, AVX2 is enabled per function and only used when the CPU
+// supports it (see blp_cpu_level())
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#   define BLP_USE_SSE2 1
+#   include <emmintrin.h>
+#else
+#   define BLP_USE_SSE2 0
+#endif
+
+#if BLP_USE_SSE2 && (defined(__GNUC__) || defined(_MSC_VER))
+#   define BLP_USE_AVX2 1
+#   include <immintrin.h>
+#else
+#   define BLP_USE_AVX2 0
+#endif
+
+#if defined(_MSC_VER)
+#   define BLP_TARGET_AVX2
+#else
+#   define BLP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef _BOUNDED_QUEUE_H_
+#define _BOUNDED_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+
+// A fixed-capacity, lock-free queue usable by several producers and consumers
+// at once (Dmitry Vyukov's bounded MPMC queue).
+//
+// Each cell holds a sequence number telling whether it is ready to be written
+// (sequence == position) or read (sequence == position + 1) for the current
+// turn, so the producers and the consumers only contend on their own index.
+// The operations never block: it's up to the caller to wait or do something
+// else when the queue is full or empty.
+template <typename T>
+class tBoundedQueue
+{
+public:
+    // The capacity is rounded up to a power of two
+    explicit tBoundedQueue(size_t capacity)
+    : enqueuePos(0), dequeuePos(0)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+
+        mask = size - 1;
+        cells.reset(new tCell[size]);
+
+        for (size_t i = 0; i < size; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    tBoundedQueue(const tBoundedQueue&) = delete;
+    tBoundedQueue& operator=(const tBoundedQueue&) = delete;
+
+    size_t capacity() const { return mask + 1; }
+
+    // Returns false if the queue is full, 'item' is only moved on success
+    bool tryPush(T& item)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        tCell* pCell;
+
+        while (true)
+        {
+            pCell = &cells[pos & mask];
+            size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(sequence) - ptrdiff_t(pos);
+
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        pCell->data = std::move(item);
+        pCell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool tryPop(T& item)
+    {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        tCell* pCell;
+
+        while (true)
+        {
+            pCell = &cells[pos & mask];
+            size_t sequence = pCell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t diff = ptrdiff_t(sequence) - ptrdiff_t(pos + 1);
+
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        item = std::move(pCell->data);
+        pCell->data = T();
+        pCell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct tCell
+    {
+        std::atomic<size_t> sequence;
+        T                   data;
+    };
+
+    // The indices are on their own cache lines, so the producers and the
+    // consumers don't slow each other down
+    alignas(64) std::unique_ptr<tCell[]>    cells;
+    size_t                                  mask;
+    alignas(64) std::atomic<size_t>         enqueuePos;
+    alignas(64) std::atomic<size_t>         dequeuePos;
+};
+
+#endif
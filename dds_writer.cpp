@@ -0,0 +1,131 @@
+#include "dds_writer.h"
+
+#include <algorithm>
+
+
+// Flags of the header
+static const uint32_t DDSD_CAPS         = 0x00000001;
+static const uint32_t DDSD_HEIGHT       = 0x00000002;
+static const uint32_t DDSD_WIDTH        = 0x00000004;
+static const uint32_t DDSD_PITCH        = 0x00000008;
+static const uint32_t DDSD_PIXELFORMAT  = 0x00001000;
+static const uint32_t DDSD_MIPMAPCOUNT  = 0x00020000;
+static const uint32_t DDSD_LINEARSIZE   = 0x00080000;
+
+// Flags of the pixel format
+static const uint32_t DDPF_ALPHAPIXELS  = 0x00000001;
+static const uint32_t DDPF_FOURCC       = 0x00000004;
+static const uint32_t DDPF_RGB          = 0x00000040;
+
+// Capabilities
+static const uint32_t DDSCAPS_COMPLEX   = 0x00000008;
+static const uint32_t DDSCAPS_TEXTURE   = 0x00001000;
+static const uint32_t DDSCAPS_MIPMAP    = 0x00400000;
+
+
+static void appendUInt32(std::vector<uint8_t>& data, uint32_t value)
+{
+    const uint8_t bytes[] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+    data.insert(data.end(), bytes, bytes + 4);
+}
+
+
+static uint32_t fourCC(const char* code)
+{
+    return uint32_t(uint8_t(code[0])) | (uint32_t(uint8_t(code[1])) << 8) | (uint32_t(uint8_t(code[2])) << 16) |
+           (uint32_t(uint8_t(code[3])) << 24);
+}
+
+
+// Size in bytes of a mip level
+static size_t levelSize(tDDSFormat format, unsigned int width, unsigned int height)
+{
+    const size_t nbBlocks = size_t((width + 3) / 4) * ((height + 3) / 4);
+
+    switch (format)
+    {
+        case DDS_FORMAT_DXT1:   return nbBlocks * 8;
+        case DDS_FORMAT_DXT3:
+        case DDS_FORMAT_DXT5:   return nbBlocks * 16;
+        default:                return size_t(width) * height * 4;
+    }
+}
+
+
+bool ddsEncode(tDDSFormat format, unsigned int width, unsigned int height, const std::vector<tDDSLevel>& levels,
+               std::vector<uint8_t>& dds)
+{
+    if ((width == 0) || (height == 0) || levels.empty())
+        return false;
+
+    size_t totalSize = 0;
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        if (levels[i].size != levelSize(format, std::max(width >> i, 1u), std::max(height >> i, 1u)))
+            return false;
+
+        totalSize += levels[i].size;
+    }
+
+    const bool bCompressed = (format != DDS_FORMAT_BGRA8);
+    const bool bMipmaps = (levels.size() > 1);
+
+    dds.clear();
+    dds.reserve(128 + totalSize);
+
+    appendUInt32(dds, fourCC("DDS "));
+
+    // DDS_HEADER
+    appendUInt32(dds, 124);
+    appendUInt32(dds, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                      (bCompressed ? DDSD_LINEARSIZE : DDSD_PITCH) | (bMipmaps ? DDSD_MIPMAPCOUNT : 0));
+    appendUInt32(dds, height);
+    appendUInt32(dds, width);
+    appendUInt32(dds, uint32_t(bCompressed ? levels[0].size : size_t(width) * 4));
+    appendUInt32(dds, 0);                              // Depth
+    appendUInt32(dds, uint32_t(levels.size()));
+
+    for (unsigned int i = 0; i < 11; ++i)
+        appendUInt32(dds, 0);
+
+    // DDS_PIXELFORMAT
+    appendUInt32(dds, 32);
+
+    switch (format)
+    {
+        case DDS_FORMAT_DXT1:
+        case DDS_FORMAT_DXT3:
+        case DDS_FORMAT_DXT5:
+        {
+            static const char* CODES[] = { "DXT1", "DXT3", "DXT5" };
+
+            appendUInt32(dds, DDPF_FOURCC);
+            appendUInt32(dds, fourCC(CODES[format]));
+
+            for (unsigned int i = 0; i < 5; ++i)
+                appendUInt32(dds, 0);
+            break;
+        }
+
+        default:
+            appendUInt32(dds, DDPF_RGB | DDPF_ALPHAPIXELS);
+            appendUInt32(dds, 0);
+            appendUInt32(dds, 32);
+            appendUInt32(dds, 0x00FF0000);
+            appendUInt32(dds, 0x0000FF00);
+            appendUInt32(dds, 0x000000FF);
+            appendUInt32(dds, 0xFF000000);
+            break;
+    }
+
+    appendUInt32(dds, DDSCAPS_TEXTURE | (bMipmaps ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0));
+
+    for (unsigned int i = 0; i < 4; ++i)
+        appendUInt32(dds, 0);
+
+    // The levels, back to back
+    for (const tDDSLevel& level : levels)
+        dds.insert(dds.end(), level.pData, level.pData + level.size);
+
+    return true;
+}
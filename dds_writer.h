@@ -0,0 +1,31 @@
+#ifndef _DDS_WRITER_H_
+#define _DDS_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+enum tDDSFormat
+{
+    DDS_FORMAT_DXT1,
+    DDS_FORMAT_DXT3,
+    DDS_FORMAT_DXT5,
+    DDS_FORMAT_BGRA8,       // Uncompressed, 32 bits per pixel
+};
+
+
+// The blocks or the pixels (with tightly packed rows) of a mip level
+struct tDDSLevel
+{
+    const uint8_t*  pData;
+    size_t          size;
+};
+
+
+// Writes the mip levels (the biggest one first, each one half the size of the previous one) as a
+// DDS file. Returns false if the size of a level doesn't match its dimensions.
+bool ddsEncode(tDDSFormat format, unsigned int width, unsigned int height, const std::vector<tDDSLevel>& levels,
+               std::vector<uint8_t>& dds);
+
+#endif
@@ -118,6 +118,14 @@ bool ClusterFit::ConstructOrdering( Vec3 const& axis, int iteration )
 
 void ClusterFit::Compress3( void* block )
 {
+#if SQUISH_USE_AVX2
+	if( CpuHasAvx2() )
+	{
+		Compress3Avx2( block );
+		return;
+	}
+#endif
+
 	// declare variables
 	int const count = m_colours->GetCount();
 	Vec4 const two = VEC4_CONST( 2.0 );
@@ -135,7 +143,6 @@ void ClusterFit::Compress3( void* block )
 	Vec4 beststart = VEC4_CONST( 0.0f );
 	Vec4 bestend = VEC4_CONST( 0.0f );
 	Vec4 besterror = m_besterror;
-	u8 bestindices[16];
 	int bestiteration = 0;
 	int besti = 0, bestj = 0;
 	
@@ -221,32 +228,19 @@ void ClusterFit::Compress3( void* block )
 			break;
 	}
 		
-	// save the block if necessary
-	if( CompareAnyLessThan( besterror, m_besterror ) )
-	{
-		// remap the indices
-		u8 const* order = ( u8* )m_order + 16*bestiteration;
-
-		u8 unordered[16];
-		for( int m = 0; m < besti; ++m )
-			unordered[order[m]] = 0;
-		for( int m = besti; m < bestj; ++m )
-			unordered[order[m]] = 2;
-		for( int m = bestj; m < count; ++m )
-			unordered[order[m]] = 1;
-
-		m_colours->RemapIndices( unordered, bestindices );
-		
-		// save the block
-		WriteColourBlock3( beststart.GetVec3(), bestend.GetVec3(), bestindices, block );
-
-		// save the error
-		m_besterror = besterror;
-	}
+	SaveBlock3( bestiteration, besti, bestj, beststart, bestend, besterror, block );
 }
 
 void ClusterFit::Compress4( void* block )
 {
+#if SQUISH_USE_AVX2
+	if( CpuHasAvx2() )
+	{
+		Compress4Avx2( block );
+		return;
+	}
+#endif
+
 	// declare variables
 	int const count = m_colours->GetCount();
 	Vec4 const two = VEC4_CONST( 2.0f );
@@ -266,7 +260,6 @@ void ClusterFit::Compress4( void* block )
 	Vec4 beststart = VEC4_CONST( 0.0f );
 	Vec4 bestend = VEC4_CONST( 0.0f );
 	Vec4 besterror = m_besterror;
-	u8 bestindices[16];
 	int bestiteration = 0;
 	int besti = 0, bestj = 0, bestk = 0;
 	
@@ -364,11 +357,49 @@ void ClusterFit::Compress4( void* block )
 			break;
 	}
 
+	SaveBlock4( bestiteration, besti, bestj, bestk, beststart, bestend, besterror, block );
+}
+
+void ClusterFit::SaveBlock3( int iteration, int besti, int bestj, Vec4::Arg beststart, Vec4::Arg bestend,
+						   Vec4::Arg besterror, void* block )
+{
+	int const count = m_colours->GetCount();
+
+	// save the block if necessary
+	if( CompareAnyLessThan( besterror, m_besterror ) )
+	{
+		// remap the indices
+		u8 const* order = ( u8* )m_order + 16*iteration;
+
+		u8 unordered[16];
+		for( int m = 0; m < besti; ++m )
+			unordered[order[m]] = 0;
+		for( int m = besti; m < bestj; ++m )
+			unordered[order[m]] = 2;
+		for( int m = bestj; m < count; ++m )
+			unordered[order[m]] = 1;
+
+		u8 bestindices[16];
+		m_colours->RemapIndices( unordered, bestindices );
+		
+		// save the block
+		WriteColourBlock3( beststart.GetVec3(), bestend.GetVec3(), bestindices, block );
+
+		// save the error
+		m_besterror = besterror;
+	}
+}
+
+void ClusterFit::SaveBlock4( int iteration, int besti, int bestj, int bestk, Vec4::Arg beststart,
+						   Vec4::Arg bestend, Vec4::Arg besterror, void* block )
+{
+	int const count = m_colours->GetCount();
+
 	// save the block if necessary
 	if( CompareAnyLessThan( besterror, m_besterror ) )
 	{
 		// remap the indices
-		u8 const* order = ( u8* )m_order + 16*bestiteration;
+		u8 const* order = ( u8* )m_order + 16*iteration;
 
 		u8 unordered[16];
 		for( int m = 0; m < besti; ++m )
@@ -380,6 +411,7 @@ void ClusterFit::Compress4( void* block )
 		for( int m = bestk; m < count; ++m )
 			unordered[order[m]] = 1;
 
+		u8 bestindices[16];
 		m_colours->RemapIndices( unordered, bestindices );
 		
 		// save the block
@@ -34,6 +34,11 @@
 
 namespace squish {
 
+#if SQUISH_USE_AVX2
+//! Returns true if the CPU (and the OS) supports AVX2, detected once
+bool CpuHasAvx2();
+#endif
+
 class ClusterFit : public ColourFit
 {
 public:
@@ -45,6 +50,17 @@ private:
 	virtual void Compress3( void* block );
 	virtual void Compress4( void* block );
 
+#if SQUISH_USE_AVX2
+	// Same as Compress3() and Compress4(), with two clusterings evaluated at once
+	void Compress3Avx2( void* block );
+	void Compress4Avx2( void* block );
+#endif
+
+	void SaveBlock3( int iteration, int besti, int bestj, Vec4::Arg beststart, Vec4::Arg bestend,
+					 Vec4::Arg besterror, void* block );
+	void SaveBlock4( int iteration, int besti, int bestj, int bestk, Vec4::Arg beststart,
+					 Vec4::Arg bestend, Vec4::Arg besterror, void* block );
+
 	enum { kMaxIterations = 8 };
 
 	int m_iterationCount;
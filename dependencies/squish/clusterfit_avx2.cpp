@@ -0,0 +1,385 @@
+/* -----------------------------------------------------------------------------
+
+	Copyright (c) 2006 Simon Brown                          si@sjbrown.co.uk
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files (the
+	"Software"), to	deal in the Software without restriction, including
+	without limitation the rights to use, copy, modify, merge, publish,
+	distribute, sublicense, and/or sell copies of the Software, and to
+	permit persons to whom the Software is furnished to do so, subject to
+	the following conditions:
+
+	The above copyright notice and this permission notice shall be included
+	in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+	OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+	CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+	TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+	SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+   -------------------------------------------------------------------------- */
+
+// The cluster fit of clusterfit.cpp, with two clusterings evaluated at once: each 128-bit lane of
+// the AVX registers goes through exactly the same operations as a Vec4 of simd_sse.h (there is no
+// fused multiply-add), so the blocks are identical to the ones of the SSE version.
+
+#include "clusterfit.h"
+
+#if SQUISH_USE_AVX2
+
+#include "colourset.h"
+#include <immintrin.h>
+#include <cfloat>
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#define SQUISH_TARGET_AVX2
+#else
+#define SQUISH_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#endif
+
+namespace squish {
+
+static bool DetectAvx2()
+{
+#if defined( _MSC_VER )
+	int infos[4];
+
+	__cpuid( infos, 0 );
+	if( infos[0] < 7 )
+		return false;
+
+	// the OS must also save the YMM registers (OSXSAVE + XCR0)
+	__cpuid( infos, 1 );
+	bool osxsave = ( infos[2] & ( 1 << 27 ) ) != 0;
+	bool avx = ( infos[2] & ( 1 << 28 ) ) != 0;
+	if( !osxsave || !avx || ( _xgetbv( 0 ) & 0x6 ) != 0x6 )
+		return false;
+
+	__cpuidex( infos, 7, 0 );
+	return ( infos[1] & ( 1 << 5 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+bool CpuHasAvx2()
+{
+	static bool const avx2 = DetectAvx2();
+	return avx2;
+}
+
+//! A Vec4 in both lanes
+SQUISH_TARGET_AVX2 static inline __m256 Broadcast( Vec4::Arg v )
+{
+	__m128 const m = v.GetM128();
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( m ), m, 1 );
+}
+
+//! Two Vec4, one per lane
+SQUISH_TARGET_AVX2 static inline __m256 Combine( Vec4::Arg low, Vec4::Arg high )
+{
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( low.GetM128() ), high.GetM128(), 1 );
+}
+
+//! Returns a*b + c
+SQUISH_TARGET_AVX2 static inline __m256 MultiplyAdd( __m256 a, __m256 b, __m256 c )
+{
+	return _mm256_add_ps( _mm256_mul_ps( a, b ), c );
+}
+
+//! Returns -( a*b - c )
+SQUISH_TARGET_AVX2 static inline __m256 NegativeMultiplySubtract( __m256 a, __m256 b, __m256 c )
+{
+	return _mm256_sub_ps( c, _mm256_mul_ps( a, b ) );
+}
+
+//! Least-squares optimal end points of the clusterings of both lanes, and their error (in all the
+//! elements of each lane)
+struct Candidates
+{
+	__m256 start;
+	__m256 end;
+	__m256 error;
+};
+
+SQUISH_TARGET_AVX2 static inline Candidates Evaluate( __m256 alphax_sum, __m256 betax_sum, __m256 alphabeta_sum,
+													 __m256 metric )
+{
+	__m256 const two = _mm256_set1_ps( 2.0f );
+	__m256 const one = _mm256_set1_ps( 1.0f );
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const half = _mm256_set1_ps( 0.5f );
+	__m256 const grid = _mm256_setr_ps( 31.0f, 63.0f, 31.0f, 0.0f, 31.0f, 63.0f, 31.0f, 0.0f );
+	__m256 const gridrcp = _mm256_setr_ps( 1.0f/31.0f, 1.0f/63.0f, 1.0f/31.0f, 0.0f,
+										   1.0f/31.0f, 1.0f/63.0f, 1.0f/31.0f, 0.0f );
+
+	__m256 const alpha2_sum = _mm256_shuffle_ps( alphax_sum, alphax_sum, SQUISH_SSE_SPLAT( 3 ) );
+	__m256 const beta2_sum = _mm256_shuffle_ps( betax_sum, betax_sum, SQUISH_SSE_SPLAT( 3 ) );
+
+	// compute the least-squares optimal points (see Reciprocal() for the refinement)
+	__m256 const denominator = NegativeMultiplySubtract( alphabeta_sum, alphabeta_sum, _mm256_mul_ps( alpha2_sum, beta2_sum ) );
+	__m256 const estimate = _mm256_rcp_ps( denominator );
+	__m256 const diff = _mm256_sub_ps( one, _mm256_mul_ps( estimate, denominator ) );
+	__m256 const factor = _mm256_add_ps( _mm256_mul_ps( diff, estimate ), estimate );
+
+	__m256 a = _mm256_mul_ps( NegativeMultiplySubtract( betax_sum, alphabeta_sum, _mm256_mul_ps( alphax_sum, beta2_sum ) ), factor );
+	__m256 b = _mm256_mul_ps( NegativeMultiplySubtract( alphax_sum, alphabeta_sum, _mm256_mul_ps( betax_sum, alpha2_sum ) ), factor );
+
+	// clamp to the grid
+	a = _mm256_min_ps( one, _mm256_max_ps( zero, a ) );
+	b = _mm256_min_ps( one, _mm256_max_ps( zero, b ) );
+	a = _mm256_mul_ps( _mm256_round_ps( MultiplyAdd( grid, a, half ), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC ), gridrcp );
+	b = _mm256_mul_ps( _mm256_round_ps( MultiplyAdd( grid, b, half ), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC ), gridrcp );
+
+	// compute the error (we skip the constant xxsum)
+	__m256 const e1 = MultiplyAdd( _mm256_mul_ps( a, a ), alpha2_sum, _mm256_mul_ps( _mm256_mul_ps( b, b ), beta2_sum ) );
+	__m256 const e2 = NegativeMultiplySubtract( a, alphax_sum, _mm256_mul_ps( _mm256_mul_ps( a, b ), alphabeta_sum ) );
+	__m256 const e3 = NegativeMultiplySubtract( b, betax_sum, e2 );
+	__m256 const e4 = MultiplyAdd( two, e3, e1 );
+
+	// apply the metric to the error term
+	__m256 const e5 = _mm256_mul_ps( e4, metric );
+
+	Candidates candidates;
+	candidates.start = a;
+	candidates.end = b;
+	candidates.error = _mm256_add_ps( _mm256_add_ps( _mm256_shuffle_ps( e5, e5, SQUISH_SSE_SPLAT( 0 ) ),
+													 _mm256_shuffle_ps( e5, e5, SQUISH_SSE_SPLAT( 1 ) ) ),
+									  _mm256_shuffle_ps( e5, e5, SQUISH_SSE_SPLAT( 2 ) ) );
+	return candidates;
+}
+
+//! Returns a bit per lane whose error is lower than the best one
+SQUISH_TARGET_AVX2 static inline int CompareLessThan( Candidates const& candidates, Vec4::Arg besterror )
+{
+	__m256 const bits = _mm256_cmp_ps( candidates.error, Broadcast( besterror ), _CMP_LT_OS );
+	int const mask = _mm256_movemask_ps( bits );
+	return ( ( mask & 0x0F ) != 0 ? 1 : 0 ) | ( ( mask & 0xF0 ) != 0 ? 2 : 0 );
+}
+
+SQUISH_TARGET_AVX2 static inline Vec4 Lane( __m256 v, int lane )
+{
+	return Vec4( lane == 0 ? _mm256_castps256_ps128( v ) : _mm256_extractf128_ps( v, 1 ) );
+}
+
+SQUISH_TARGET_AVX2 void ClusterFit::Compress3Avx2( void* block )
+{
+	// declare variables
+	int const count = m_colours->GetCount();
+	__m256 const half_half2 = _mm256_setr_ps( 0.5f, 0.5f, 0.5f, 0.25f, 0.5f, 0.5f, 0.5f, 0.25f );
+	__m256 const metric = Broadcast( m_metric );
+
+	// prepare an ordering using the principle axis
+	ConstructOrdering( m_principle, 0 );
+
+	// check all possible clusters and iterate on the total order
+	Vec4 beststart = VEC4_CONST( 0.0f );
+	Vec4 bestend = VEC4_CONST( 0.0f );
+	Vec4 besterror = m_besterror;
+	int bestiteration = 0;
+	int besti = 0, bestj = 0;
+
+	// loop over iterations (we avoid the case that all points in first or last cluster)
+	for( int iterationIndex = 0;; )
+	{
+		__m256 const xsum_wsum = Broadcast( m_xsum_wsum );
+
+		// first cluster [0,i) is at the start
+		Vec4 part0 = VEC4_CONST( 0.0f );
+		for( int i = 0; i < count; ++i )
+		{
+			__m256 const part0x2 = Broadcast( part0 );
+
+			// second cluster [i,j) is half along, for j and j + 1 (if j < count)
+			Vec4 part1 = ( i == 0 ) ? m_points_weights[0] : VEC4_CONST( 0.0f );
+			int jmin = ( i == 0 ) ? 1 : i;
+			for( int j = jmin;; )
+			{
+				Vec4 const part1next = ( j < count ) ? part1 + m_points_weights[j] : part1;
+				__m256 const part1x2 = Combine( part1, part1next );
+
+				// last cluster [j,count) is at the end
+				__m256 const part2x2 = _mm256_sub_ps( _mm256_sub_ps( xsum_wsum, part1x2 ), part0x2 );
+
+				// compute least squares terms directly
+				__m256 const alphax_sum = MultiplyAdd( part1x2, half_half2, part0x2 );
+				__m256 const betax_sum = MultiplyAdd( part1x2, half_half2, part2x2 );
+				__m256 const alphabeta = _mm256_mul_ps( part1x2, half_half2 );
+				__m256 const alphabeta_sum = _mm256_shuffle_ps( alphabeta, alphabeta, SQUISH_SSE_SPLAT( 3 ) );
+
+				Candidates const candidates = Evaluate( alphax_sum, betax_sum, alphabeta_sum, metric );
+
+				// keep the solutions if they win, in order
+				if( CompareLessThan( candidates, besterror ) != 0 )
+				{
+					int const lanes = ( j < count ) ? 2 : 1;
+					for( int lane = 0; lane < lanes; ++lane )
+					{
+						Vec4 const error = Lane( candidates.error, lane );
+						if( CompareAnyLessThan( error, besterror ) )
+						{
+							beststart = Lane( candidates.start, lane );
+							bestend = Lane( candidates.end, lane );
+							besti = i;
+							bestj = j + lane;
+							besterror = error;
+							bestiteration = iterationIndex;
+						}
+					}
+				}
+
+				// advance
+				if( j + 1 >= count )
+					break;
+				part1 = part1next + m_points_weights[j + 1];
+				j += 2;
+			}
+
+			// advance
+			part0 += m_points_weights[i];
+		}
+
+		// stop if we didn't improve in this iteration
+		if( bestiteration != iterationIndex )
+			break;
+
+		// advance if possible
+		++iterationIndex;
+		if( iterationIndex == m_iterationCount )
+			break;
+
+		// stop if a new iteration is an ordering that has already been tried
+		Vec3 axis = ( bestend - beststart ).GetVec3();
+		if( !ConstructOrdering( axis, iterationIndex ) )
+			break;
+	}
+
+	SaveBlock3( bestiteration, besti, bestj, beststart, bestend, besterror, block );
+}
+
+SQUISH_TARGET_AVX2 void ClusterFit::Compress4Avx2( void* block )
+{
+	// declare variables
+	int const count = m_colours->GetCount();
+	__m256 const onethird_onethird2 = _mm256_setr_ps( 1.0f/3.0f, 1.0f/3.0f, 1.0f/3.0f, 1.0f/9.0f,
+													  1.0f/3.0f, 1.0f/3.0f, 1.0f/3.0f, 1.0f/9.0f );
+	__m256 const twothirds_twothirds2 = _mm256_setr_ps( 2.0f/3.0f, 2.0f/3.0f, 2.0f/3.0f, 4.0f/9.0f,
+														2.0f/3.0f, 2.0f/3.0f, 2.0f/3.0f, 4.0f/9.0f );
+	__m256 const twonineths = _mm256_set1_ps( 2.0f/9.0f );
+	__m256 const metric = Broadcast( m_metric );
+
+	// prepare an ordering using the principle axis
+	ConstructOrdering( m_principle, 0 );
+
+	// check all possible clusters and iterate on the total order
+	Vec4 beststart = VEC4_CONST( 0.0f );
+	Vec4 bestend = VEC4_CONST( 0.0f );
+	Vec4 besterror = m_besterror;
+	int bestiteration = 0;
+	int besti = 0, bestj = 0, bestk = 0;
+
+	// loop over iterations (we avoid the case that all points in first or last cluster)
+	for( int iterationIndex = 0;; )
+	{
+		__m256 const xsum_wsum = Broadcast( m_xsum_wsum );
+
+		// first cluster [0,i) is at the start
+		Vec4 part0 = VEC4_CONST( 0.0f );
+		for( int i = 0; i < count; ++i )
+		{
+			__m256 const part0x2 = Broadcast( part0 );
+
+			// second cluster [i,j) is one third along
+			Vec4 part1 = VEC4_CONST( 0.0f );
+			for( int j = i;; )
+			{
+				__m256 const part1x2 = Broadcast( part1 );
+				__m256 const alphax_base = MultiplyAdd( part1x2, twothirds_twothirds2, part0x2 );
+
+				// third cluster [j,k) is two thirds along, for k and k + 1 (if k < count)
+				Vec4 part2 = ( j == 0 ) ? m_points_weights[0] : VEC4_CONST( 0.0f );
+				int kmin = ( j == 0 ) ? 1 : j;
+				for( int k = kmin;; )
+				{
+					Vec4 const part2next = ( k < count ) ? part2 + m_points_weights[k] : part2;
+					__m256 const part2x2 = Combine( part2, part2next );
+
+					// last cluster [k,count) is at the end
+					__m256 const part3x2 = _mm256_sub_ps( _mm256_sub_ps( _mm256_sub_ps( xsum_wsum, part2x2 ), part1x2 ), part0x2 );
+
+					// compute least squares terms directly
+					__m256 const alphax_sum = MultiplyAdd( part2x2, onethird_onethird2, alphax_base );
+					__m256 const betax_sum = MultiplyAdd( part1x2, onethird_onethird2, MultiplyAdd( part2x2, twothirds_twothirds2, part3x2 ) );
+					__m256 const part12 = _mm256_add_ps( part1x2, part2x2 );
+					__m256 const alphabeta_sum = _mm256_mul_ps( twonineths, _mm256_shuffle_ps( part12, part12, SQUISH_SSE_SPLAT( 3 ) ) );
+
+					Candidates const candidates = Evaluate( alphax_sum, betax_sum, alphabeta_sum, metric );
+
+					// keep the solutions if they win, in order
+					if( CompareLessThan( candidates, besterror ) != 0 )
+					{
+						int const lanes = ( k < count ) ? 2 : 1;
+						for( int lane = 0; lane < lanes; ++lane )
+						{
+							Vec4 const error = Lane( candidates.error, lane );
+							if( CompareAnyLessThan( error, besterror ) )
+							{
+								beststart = Lane( candidates.start, lane );
+								bestend = Lane( candidates.end, lane );
+								besterror = error;
+								besti = i;
+								bestj = j;
+								bestk = k + lane;
+								bestiteration = iterationIndex;
+							}
+						}
+					}
+
+					// advance
+					if( k + 1 >= count )
+						break;
+					part2 = part2next + m_points_weights[k + 1];
+					k += 2;
+				}
+
+				// advance
+				if( j == count )
+					break;
+				part1 += m_points_weights[j];
+				++j;
+			}
+
+			// advance
+			part0 += m_points_weights[i];
+		}
+
+		// stop if we didn't improve in this iteration
+		if( bestiteration != iterationIndex )
+			break;
+
+		// advance if possible
+		++iterationIndex;
+		if( iterationIndex == m_iterationCount )
+			break;
+
+		// stop if a new iteration is an ordering that has already been tried
+		Vec3 axis = ( bestend - beststart ).GetVec3();
+		if( !ConstructOrdering( axis, iterationIndex ) )
+			break;
+	}
+
+	SaveBlock4( bestiteration, besti, bestj, bestk, beststart, bestend, besterror, block );
+}
+
+} // namespace squish
+
+#endif // SQUISH_USE_AVX2
@@ -31,15 +31,24 @@
 #define SQUISH_USE_ALTIVEC 0
 #endif
 
-// Set to 1 or 2 when building squish to use SSE or SSE2 instructions.
+// Set to 1, 2 or 4 when building squish to use SSE, SSE2 or SSE4.1 instructions.
 #ifndef SQUISH_USE_SSE
 #define SQUISH_USE_SSE 0
 #endif
 
+// Set to 1 to also build an AVX2 version of the cluster fit, used only when the CPU supports it
+// (needs SSE2).
+#ifndef SQUISH_USE_AVX2
+#define SQUISH_USE_AVX2 0
+#endif
+
 // Internally et SQUISH_USE_SIMD when either Altivec or SSE is available.
 #if SQUISH_USE_ALTIVEC && SQUISH_USE_SSE
 #error "Cannot enable both Altivec and SSE!"
 #endif
+#if SQUISH_USE_AVX2 && ( SQUISH_USE_SSE < 2 )
+#error "The AVX2 cluster fit needs SSE2!"
+#endif
 #if SQUISH_USE_ALTIVEC || SQUISH_USE_SSE
 #define SQUISH_USE_SIMD 1
 #else
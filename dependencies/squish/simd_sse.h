@@ -30,6 +30,9 @@
 #if ( SQUISH_USE_SSE > 1 )
 #include <emmintrin.h>
 #endif
+#if ( SQUISH_USE_SSE > 2 )
+#include <smmintrin.h>
+#endif
 
 #define SQUISH_SSE_SPLAT( a )										\
 	( ( a ) | ( ( a ) << 2 ) | ( ( a ) << 4 ) | ( ( a ) << 6 ) )
@@ -73,6 +76,8 @@ public:
 		return Vec3( c[0], c[1], c[2] );
 	}
 	
+	__m128 GetM128() const { return m_v; }
+
 	Vec4 SplatX() const { return Vec4( _mm_shuffle_ps( m_v, m_v, SQUISH_SSE_SPLAT( 0 ) ) ); }
 	Vec4 SplatY() const { return Vec4( _mm_shuffle_ps( m_v, m_v, SQUISH_SSE_SPLAT( 1 ) ) ); }
 	Vec4 SplatZ() const { return Vec4( _mm_shuffle_ps( m_v, m_v, SQUISH_SSE_SPLAT( 2 ) ) ); }
@@ -158,9 +163,12 @@ public:
 		// clear out the MMX multimedia state to allow FP calls later
 		_mm_empty(); 
 		return Vec4( truncated );
-#else
+#elif ( SQUISH_USE_SSE == 2 )
 		// use SSE2 instructions
 		return Vec4( _mm_cvtepi32_ps( _mm_cvttps_epi32( v.m_v ) ) );
+#else
+		// round towards zero in one SSE4.1 instruction
+		return Vec4( _mm_round_ps( v.m_v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC ) );
 #endif
 	}
 	
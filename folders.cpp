@@ -0,0 +1,96 @@
+#include "folders.h"
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <dirent.h>
+#   include <errno.h>
+#   include <sys/stat.h>
+#endif
+
+
+bool listFolder(const std::string& strFolder, std::vector<std::string>& files,
+                std::vector<std::string>& folders)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE hFind = FindFirstFileA((strFolder + "\\*").c_str(), &entry);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        std::string strName = entry.cFileName;
+        if ((strName == ".") || (strName == ".."))
+            continue;
+
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            continue;
+
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            folders.push_back(strName);
+        else
+            files.push_back(strName);
+    }
+    while (FindNextFileA(hFind, &entry));
+
+    FindClose(hFind);
+#else
+    DIR* pDir = opendir(strFolder.c_str());
+    if (!pDir)
+        return false;
+
+    while (struct dirent* pEntry = readdir(pDir))
+    {
+        std::string strName = pEntry->d_name;
+        if ((strName == ".") || (strName == ".."))
+            continue;
+
+        bool bFolder = (pEntry->d_type == DT_DIR);
+
+        // Not all the file systems provide the type of the entries
+        if (pEntry->d_type == DT_UNKNOWN)
+        {
+            struct stat infos;
+            if (lstat((strFolder + "/" + strName).c_str(), &infos) != 0)
+                continue;
+
+            bFolder = S_ISDIR(infos.st_mode);
+        }
+
+        if (bFolder)
+            folders.push_back(strName);
+        else
+            files.push_back(strName);
+    }
+
+    closedir(pDir);
+#endif
+
+    return true;
+}
+
+
+static bool makeFolder(const std::string& strFolder)
+{
+#ifdef _WIN32
+    return CreateDirectoryA(strFolder.c_str(), nullptr) || (GetLastError() == ERROR_ALREADY_EXISTS);
+#else
+    return (mkdir(strFolder.c_str(), 0755) == 0) || (errno == EEXIST);
+#endif
+}
+
+
+bool makeFolders(const std::string& strFolder)
+{
+    // Create each parent in turn (the root of the path or a drive can't be created, so only the
+    // last folder must succeed)
+    for (size_t offset = 1; offset < strFolder.size(); ++offset)
+    {
+        if ((strFolder[offset] == '/') || (strFolder[offset] == '\\'))
+            makeFolder(strFolder.substr(0, offset));
+    }
+
+    return makeFolder(strFolder);
+}
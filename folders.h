@@ -0,0 +1,16 @@
+#ifndef _FOLDERS_H_
+#define _FOLDERS_H_
+
+#include <string>
+#include <vector>
+
+
+// Names of the files and subfolders of a folder (without '.' and '..'). The symbolic links to
+// folders aren't followed. Returns false if the folder can't be read.
+bool listFolder(const std::string& strFolder, std::vector<std::string>& files,
+                std::vector<std::string>& folders);
+
+// Creates a folder and its missing parents
+bool makeFolders(const std::string& strFolder);
+
+#endif
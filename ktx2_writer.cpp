@@ -0,0 +1,193 @@
+#include "ktx2_writer.h"
+
+#include <algorithm>
+
+
+static const uint8_t IDENTIFIER[] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Size of the header (with the identifier) and of the index, before the level index
+static const size_t HEADER_SIZE = 80;
+
+// Khronos Data Format values used by the data format descriptor
+static const uint32_t KHR_DF_MODEL_RGBSDA           = 1;
+static const uint32_t KHR_DF_MODEL_BC1A             = 128;
+static const uint32_t KHR_DF_MODEL_BC2              = 129;
+static const uint32_t KHR_DF_MODEL_BC3              = 130;
+static const uint32_t KHR_DF_PRIMARIES_BT709        = 1;
+static const uint32_t KHR_DF_TRANSFER_SRGB          = 2;
+
+static const uint32_t KHR_DF_CHANNEL_COLOR          = 0;   // Also red for RGBSDA
+static const uint32_t KHR_DF_CHANNEL_ALPHAPRESENT   = 1;   // BC1A only
+static const uint32_t KHR_DF_CHANNEL_GREEN          = 1;
+static const uint32_t KHR_DF_CHANNEL_BLUE           = 2;
+static const uint32_t KHR_DF_CHANNEL_ALPHA          = 15;
+static const uint32_t KHR_DF_SAMPLE_LINEAR          = 0x10; // The alpha isn't affected by the transfer function
+
+
+// Description of a format
+struct tFormatInfos
+{
+    uint32_t    vkFormat;
+    uint32_t    blockSize;      // In pixels
+    uint32_t    bytesPerBlock;
+    uint32_t    colorModel;
+};
+
+static const tFormatInfos FORMATS[] =
+{
+    { 132, 4, 8, KHR_DF_MODEL_BC1A },       // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    { 134, 4, 8, KHR_DF_MODEL_BC1A },       // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+    { 136, 4, 16, KHR_DF_MODEL_BC2 },       // VK_FORMAT_BC2_SRGB_BLOCK
+    { 138, 4, 16, KHR_DF_MODEL_BC3 },       // VK_FORMAT_BC3_SRGB_BLOCK
+    { 43, 1, 4, KHR_DF_MODEL_RGBSDA },      // VK_FORMAT_R8G8B8A8_SRGB
+};
+
+
+static void appendUInt32(std::vector<uint8_t>& data, uint32_t value)
+{
+    const uint8_t bytes[] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+    data.insert(data.end(), bytes, bytes + 4);
+}
+
+
+static void setUInt64(std::vector<uint8_t>& data, size_t offset, uint64_t value)
+{
+    for (unsigned int i = 0; i < 8; ++i)
+        data[offset + i] = uint8_t(value >> (i * 8));
+}
+
+
+// A sample of the data format descriptor: 'bitLength' bits at 'bitOffset', with values from 0 to
+// 'upper'
+static void appendSample(std::vector<uint8_t>& dfd, uint32_t channel, uint32_t bitOffset, uint32_t bitLength,
+                         uint32_t upper)
+{
+    appendUInt32(dfd, bitOffset | ((bitLength - 1) << 16) | (channel << 24));
+    appendUInt32(dfd, 0);                           // Sample position
+    appendUInt32(dfd, 0);                           // Lower
+    appendUInt32(dfd, upper);
+}
+
+
+// Data format descriptor: its total size, then one basic descriptor block
+static void appendDFD(tKTX2Format format, std::vector<uint8_t>& data)
+{
+    const tFormatInfos& infos = FORMATS[format];
+
+    std::vector<uint8_t> samples;
+    switch (format)
+    {
+        case KTX2_FORMAT_BC1_RGB:
+            appendSample(samples, KHR_DF_CHANNEL_COLOR, 0, 64, 0xFFFFFFFF);
+            break;
+
+        case KTX2_FORMAT_BC1_RGBA:
+            appendSample(samples, KHR_DF_CHANNEL_ALPHAPRESENT, 0, 64, 0xFFFFFFFF);
+            break;
+
+        case KTX2_FORMAT_BC2:
+        case KTX2_FORMAT_BC3:
+            appendSample(samples, KHR_DF_CHANNEL_ALPHA | KHR_DF_SAMPLE_LINEAR, 0, 64, 0xFFFFFFFF);
+            appendSample(samples, KHR_DF_CHANNEL_COLOR, 64, 64, 0xFFFFFFFF);
+            break;
+
+        default:
+            appendSample(samples, KHR_DF_CHANNEL_COLOR, 0, 8, 255);
+            appendSample(samples, KHR_DF_CHANNEL_GREEN, 8, 8, 255);
+            appendSample(samples, KHR_DF_CHANNEL_BLUE, 16, 8, 255);
+            appendSample(samples, KHR_DF_CHANNEL_ALPHA | KHR_DF_SAMPLE_LINEAR, 24, 8, 255);
+            break;
+    }
+
+    const uint32_t blockSize = uint32_t(24 + samples.size());
+    const uint32_t dimension = infos.blockSize - 1;
+
+    appendUInt32(data, 4 + blockSize);
+    appendUInt32(data, 0);                                      // Vendor (Khronos) and descriptor type (basic)
+    appendUInt32(data, 2 | (blockSize << 16));                  // Version 1.3
+    appendUInt32(data, infos.colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_SRGB << 16));
+    appendUInt32(data, dimension | (dimension << 8));           // Texel block dimensions, minus one
+    appendUInt32(data, infos.bytesPerBlock);                    // Bytes in plane 0
+    appendUInt32(data, 0);
+    data.insert(data.end(), samples.begin(), samples.end());
+}
+
+
+// Key/value data: only the name of the writer
+static void appendKeyValues(std::vector<uint8_t>& data)
+{
+    static const char KEY_VALUE[] = "KTXwriter\0BLPConverter";
+
+    appendUInt32(data, sizeof(KEY_VALUE));
+    data.insert(data.end(), KEY_VALUE, KEY_VALUE + sizeof(KEY_VALUE));
+
+    while (data.size() % 4 != 0)
+        data.push_back(0);
+}
+
+
+bool ktx2Encode(tKTX2Format format, unsigned int width, unsigned int height,
+                const std::vector<tKTX2Level>& levels, std::vector<uint8_t>& ktx2)
+{
+    if ((width == 0) || (height == 0) || levels.empty())
+        return false;
+
+    const tFormatInfos& infos = FORMATS[format];
+
+    size_t totalSize = 0;
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const size_t nbBlocks = size_t((std::max(width >> i, 1u) + infos.blockSize - 1) / infos.blockSize) *
+                                ((std::max(height >> i, 1u) + infos.blockSize - 1) / infos.blockSize);
+
+        if (levels[i].size != nbBlocks * infos.bytesPerBlock)
+            return false;
+
+        totalSize += levels[i].size;
+    }
+
+    ktx2.clear();
+    ktx2.reserve(512 + totalSize);
+
+    ktx2.insert(ktx2.end(), IDENTIFIER, IDENTIFIER + sizeof(IDENTIFIER));
+    appendUInt32(ktx2, infos.vkFormat);
+    appendUInt32(ktx2, 1);                                      // Type size
+    appendUInt32(ktx2, width);
+    appendUInt32(ktx2, height);
+    appendUInt32(ktx2, 0);                                      // Depth
+    appendUInt32(ktx2, 0);                                      // Layers
+    appendUInt32(ktx2, 1);                                      // Faces
+    appendUInt32(ktx2, uint32_t(levels.size()));
+    appendUInt32(ktx2, 0);                                      // Supercompression
+
+    // The index and the level index are filled once the rest is written
+    ktx2.resize(HEADER_SIZE + levels.size() * 24, 0);
+
+    const size_t dfdOffset = ktx2.size();
+    appendDFD(format, ktx2);
+
+    const size_t kvdOffset = ktx2.size();
+    appendKeyValues(ktx2);
+
+    setUInt64(ktx2, 48, uint64_t(dfdOffset) | (uint64_t(kvdOffset - dfdOffset) << 32));
+    setUInt64(ktx2, 56, uint64_t(kvdOffset) | (uint64_t(ktx2.size() - kvdOffset) << 32));
+
+    // The levels are stored from the smallest one, each one aligned on a block (all the blocks
+    // being a multiple of 4 bytes, as also required)
+    const size_t alignment = infos.bytesPerBlock;
+
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        while (ktx2.size() % alignment != 0)
+            ktx2.push_back(0);
+
+        const size_t entry = HEADER_SIZE + i * 24;
+        setUInt64(ktx2, entry, ktx2.size());
+        setUInt64(ktx2, entry + 8, levels[i].size);
+        setUInt64(ktx2, entry + 16, levels[i].size);
+
+        ktx2.insert(ktx2.end(), levels[i].pData, levels[i].pData + levels[i].size);
+    }
+
+    return true;
+}
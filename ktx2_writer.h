@@ -0,0 +1,34 @@
+#ifndef _KTX2_WRITER_H_
+#define _KTX2_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// The colors are always considered as sRGB
+enum tKTX2Format
+{
+    KTX2_FORMAT_BC1_RGB,
+    KTX2_FORMAT_BC1_RGBA,
+    KTX2_FORMAT_BC2,
+    KTX2_FORMAT_BC3,
+    KTX2_FORMAT_RGBA8,      // Uncompressed, 32 bits per pixel
+};
+
+
+// The blocks or the pixels (with tightly packed rows) of a mip level
+struct tKTX2Level
+{
+    const uint8_t*  pData;
+    size_t          size;
+};
+
+
+// Writes the mip levels (the biggest one first, each one half the size of the previous one) as a
+// KTX2 file, without supercompression. Returns false if the size of a level doesn't match its
+// dimensions.
+bool ktx2Encode(tKTX2Format format, unsigned int width, unsigned int height,
+                const std::vector<tKTX2Level>& levels, std::vector<uint8_t>& ktx2);
+
+#endif
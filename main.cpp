@@ -1,14 +1,29 @@
 #include "blp.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
+#include "bounded_queue.h"
+#include "dds_writer.h"
+#include "folders.h"
+#include "ktx2_writer.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+
 #include <SimpleOpt.h>
+#include <iomanip>
 #include <iostream>
 #include <memory.h>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
 
 using namespace std;
 
@@ -21,6 +36,24 @@ enum {
   OPT_DEST,
   OPT_FORMAT,
   OPT_MIP_LEVEL,
+  OPT_JOBS,
+  OPT_MAX_SIZE,
+  OPT_THUMBNAIL,
+  OPT_RECURSIVE,
+  OPT_REMOVE,
+  OPT_IO_THREADS,
+  OPT_QUEUE_DEPTH,
+  OPT_PNG_LEVEL,
+  OPT_PNG_FAST,
+  OPT_TO_BLP,
+  OPT_DXT1,
+  OPT_DXT3,
+  OPT_DXT5,
+  OPT_MIP_FILTER,
+  OPT_LINEAR,
+  OPT_QUALITY,
+  OPT_UNIFORM_METRIC,
+  OPT_WEIGHT_BY_ALPHA,
 };
 
 const CSimpleOpt::SOption COMMAND_LINE_OPTIONS[] = {
@@ -34,6 +67,26 @@ const CSimpleOpt::SOption COMMAND_LINE_OPTIONS[] = {
     {OPT_FORMAT, "--format", SO_REQ_SEP},
     {OPT_MIP_LEVEL, "-m", SO_REQ_SEP},
     {OPT_MIP_LEVEL, "--miplevel", SO_REQ_SEP},
+    {OPT_JOBS, "-j", SO_REQ_SEP},
+    {OPT_JOBS, "--jobs", SO_REQ_SEP},
+    {OPT_MAX_SIZE, "--max-size", SO_REQ_SEP},
+    {OPT_THUMBNAIL, "--thumbnail", SO_REQ_SEP},
+    {OPT_RECURSIVE, "-r", SO_REQ_SEP},
+    {OPT_RECURSIVE, "--recursive", SO_REQ_SEP},
+    {OPT_REMOVE, "--remove", SO_NONE},
+    {OPT_IO_THREADS, "--io-threads", SO_REQ_SEP},
+    {OPT_QUEUE_DEPTH, "--queue-depth", SO_REQ_SEP},
+    {OPT_PNG_LEVEL, "--png-level", SO_REQ_SEP},
+    {OPT_PNG_FAST, "--png-fast", SO_NONE},
+    {OPT_TO_BLP, "--to-blp", SO_NONE},
+    {OPT_DXT1, "--dxt1", SO_NONE},
+    {OPT_DXT3, "--dxt3", SO_NONE},
+    {OPT_DXT5, "--dxt5", SO_NONE},
+    {OPT_MIP_FILTER, "--mip-filter", SO_REQ_SEP},
+    {OPT_LINEAR, "--linear", SO_NONE},
+    {OPT_QUALITY, "--quality", SO_REQ_SEP},
+    {OPT_UNIFORM_METRIC, "--uniform-metric", SO_NONE},
+    {OPT_WEIGHT_BY_ALPHA, "--weight-by-alpha", SO_NONE},
 
     SO_END_OF_OPTIONS};
 
@@ -45,6 +98,11 @@ void showUsage(const std::string &strApplicationName) {
        << "Usage: " << strApplicationName
        << " [options] <blp_filename> [<blp_filename> ... <blp_filename>]"
        << endl
+       << "       " << strApplicationName << " [options] --recursive <folder>"
+       << endl
+       << "       " << strApplicationName
+       << " [options] --to-blp <image_filename> [... <image_filename>]"
+       << endl
        << endl
        << "Options:" << endl
        << "  --help, -h:      Display this help" << endl
@@ -54,15 +112,77 @@ void showUsage(const std::string &strApplicationName) {
        << "  --dest, -o:      Folder where the converted image(s) must be "
           "written to (default: './')"
        << endl
-       << "  --format, -f:    'png' or 'tga' (default: png)" << endl
+       << "  --format, -f:    'png', 'tga', 'dds' or 'ktx2' (default: png). "
+          "The DDS and KTX2 files contain all the mip levels (of the range "
+          "given to --miplevel), the DXT ones copied without decoding"
+       << endl
        << "  --miplevel, -m:  The specific mip level to convert (default: 0, "
-          "the bigger one)"
+          "the bigger one), or 'N-M' / 'all' to write each level of the range "
+          "in its own file (name_mipN.png)"
+       << endl
+       << "  --jobs, -j:      Number of threads decoding and compressing the "
+          "images (default: 1, 0: one per CPU core)"
+       << endl
+       << "  --max-size:      Maximum width and height of the converted images: "
+          "a smaller mip level is used, or for JPEG files a faster reduced "
+          "decode (default: 0, no limit)"
+       << endl
+       << "  --thumbnail:     'WxH', converts the images downscaled to fit in "
+          "WxH, from the smallest mip level big enough (overrides --miplevel "
+          "and --max-size)"
+       << endl
+       << "  --recursive, -r: Converts all the BLP files of a folder and its "
+          "subfolders, written in the same hierarchy of folders in the "
+          "destination one (default: in-place)"
+       << endl
+       << "  --remove:        Removes the BLP files successfully converted "
+          "(not the images given to --to-blp)"
+       << endl
+       << "  --io-threads:    Number of threads reading the BLP files and "
+          "writing the images (default: 2)"
+       << endl
+       << "  --queue-depth:   Number of files and images waiting between each "
+          "stage of the conversion, raise it to hide the latency of slow "
+          "(network) file systems (default: 16)"
+       << endl
+       << "  --png-level:     Compression level of the PNG files, from 0 (none) "
+          "to 9 (best) (default: 6)"
+       << endl
+       << "  --png-fast:      Faster choice of the filter of each row of the PNG "
+          "files, at the cost of a slightly bigger file"
+       << endl
+       << "  --to-blp:        Encodes the given image files (PNG, TGA, ...) as "
+          "BLP2 files with all their mip levels, the blocks being compressed "
+          "by all the CPU cores (or --jobs)"
+       << endl
+       << "  --dxt1, --dxt3, --dxt5: Compression of the BLP files written by "
+          "--to-blp (default: DXT5). DXT1 only keeps a 1-bit alpha channel, if "
+          "any"
+       << endl
+       << "  --mip-filter:    Filter computing the mip levels of the BLP files "
+          "written by --to-blp: box, triangle or kaiser (default: box)"
+       << endl
+       << "  --linear:        The colors of the images given to --to-blp aren't "
+          "sRGB ones, and are averaged as they are"
+       << endl
+       << "  --quality:       Compression of the blocks by --to-blp: fast, "
+          "normal, best (several times slower) or adaptive (fast for the "
+          "blocks of nearly uniform colors, normal elsewhere) (default: "
+          "normal). The PSNR and the number of blocks compressed per second by "
+          "each thread are reported"
+       << endl
+       << "  --uniform-metric: The errors on the red, green and blue channels "
+          "count the same, instead of favoring green as the eye does"
+       << endl
+       << "  --weight-by-alpha: The errors on the colors of the transparent "
+          "pixels count less"
        << endl
        << endl;
 }
 
-void showInfos(const std::string &strFileName, tBLPInfos blpInfos) {
-  cout << endl
+void showInfos(std::ostream &out, const std::string &strFileName,
+               tBLPInfos blpInfos) {
+  out << endl
        << "Infos about '" << strFileName << "':" << endl
        << "  - Version:    BLP" << (int)blp_version(blpInfos) << endl
        << "  - Format:     " << blp_as_string(blp_format(blpInfos)) << endl
@@ -72,25 +192,850 @@ void showInfos(const std::string &strFileName, tBLPInfos blpInfos) {
        << endl;
 }
 
-static void flipImageVertically(uint8_t* imageData, unsigned int width, unsigned int height, unsigned int channels)
-{
-  size_t rowSize = width * channels; // Number of bytes in a single row
-  for (unsigned int y = 0; y < height / 2; ++y)
-  {
-    // Calculate pointers to the current row and its mirrored counterpart
-    uint8_t* row1 = imageData + y * rowSize;
-    uint8_t* row2 = imageData + (height - y - 1) * rowSize;
+// Messages of one file, printed in one go once it is processed so the output
+// of the files converted in parallel doesn't get mixed up
+struct tFileResult {
+  string strFileName;
+  ostringstream out;
+  ostringstream err;
+  bool bConverted = false;
+};
 
-    // Swap the rows
-    std::swap_ranges(row1, row1 + rowSize, row2);
-  }
+// Returns the mip level and the scale of the reduced JPEG decode needed to get
+// an image not bigger than 'maxSize' (if possible)
+static void chooseResolution(tBLPInfos blpInfos, unsigned int maxSize,
+                             unsigned int &mipLevel, unsigned int &scale) {
+  scale = 1;
+  if (maxSize == 0)
+    return;
+
+  unsigned int nbMipLevels = blp_nb_mip_levels(blpInfos);
+  mipLevel = min(mipLevel, nbMipLevels - 1);
+
+  // The smaller mip levels are the cheapest to decode
+  while ((mipLevel + 1 < nbMipLevels) &&
+         ((blp_width(blpInfos, mipLevel) > maxSize) ||
+          (blp_height(blpInfos, mipLevel) > maxSize)))
+    ++mipLevel;
+
+  if (blp_format(blpInfos) != BLP_FORMAT_JPEG)
+    return;
+
+  while ((scale < 8) &&
+         (((blp_width(blpInfos, mipLevel) + scale - 1) / scale > maxSize) ||
+          ((blp_height(blpInfos, mipLevel) + scale - 1) / scale > maxSize)))
+    scale *= 2;
 }
 
-int main(int argc, char **argv) {
-  bool bInfos = false;
+// Conversion settings, shared by all the files
+struct tConversionOptions {
   string strOutputFolder = "./";
   string strFormat = "png";
-  unsigned int mipLevel = 0;
+  unsigned int firstMipLevel = 0;
+  unsigned int lastMipLevel = 0;
+  bool bMipRange = false; // Each level of the range written in its own file
+  bool bContainer = false; // All the mip levels in one file (DDS, KTX2)
+  unsigned int maxSize = 0;
+  unsigned int thumbWidth = 0;
+  unsigned int thumbHeight = 0;
+  bool bInfos = false;
+  bool bRemove = false;
+  tPNGOptions png;
+  bool bToBLP = false; // The images are encoded as BLP files instead
+  tBLPEncodeOptions blp;
+};
+
+// Results of all the files, including the ones found while walking the folders
+struct tResults {
+  mutex outputMutex; // Protects 'files' and the output
+  deque<tFileResult> files; // The elements never move once added
+
+  tFileResult *add(const string &strFileName) {
+    lock_guard<mutex> lock(outputMutex);
+    files.emplace_back();
+    files.back().strFileName = strFileName;
+    return &files.back();
+  }
+};
+
+// Parses '-m N', '-m N-M' or '-m all'
+static bool parseMipLevels(const string &strArg, tConversionOptions &options) {
+  if (strArg == "all") {
+    options.firstMipLevel = 0;
+    options.lastMipLevel = ~0u;
+    options.bMipRange = true;
+    return true;
+  }
+
+  if (strArg.find('-') != string::npos) {
+    char end;
+    if ((sscanf(strArg.c_str(), "%u-%u%c", &options.firstMipLevel,
+                &options.lastMipLevel, &end) != 2) ||
+        (options.firstMipLevel > options.lastMipLevel))
+      return false;
+
+    options.bMipRange = true;
+    return true;
+  }
+
+  options.firstMipLevel = options.lastMipLevel = atoi(strArg.c_str());
+  options.bMipRange = false;
+  return true;
+}
+
+/********************************** PIPELINE **********************************/
+
+// The conversion is split into stages connected by bounded queues:
+//
+//   files -> [read] -> images -> [decode] -> [encode] -> [write]
+//
+// The I/O threads read the BLP files and write the images, the CPU threads
+// decode the pixels and compress them. The queues let the I/O of the next and
+// previous files overlap with the work on the current ones, and their depth
+// bounds the memory used by the files in flight.
+
+// A BLP file to convert
+struct tInput {
+  string strInFileName;
+  string strOutputFolder;
+  tFileResult *pResult = nullptr;
+};
+
+// A BLP file mapped in memory. It is closed, and its result reported, once
+// all the images produced from it are written.
+struct tLoadedFile {
+  string strInFileName;
+  tBLPFile blpFile = nullptr;
+  const char *pData = nullptr; // Of the mapping
+  tBLPInfos blpInfos = nullptr; // Released with the mapping
+  vector<string> errors; // One per image, written by its stages only
+  tFileResult *pResult = nullptr;
+  const tConversionOptions *pOptions = nullptr;
+  tResults *pResults = nullptr;
+
+  ~tLoadedFile();
+};
+
+// An image produced from a BLP file, going through the stages
+struct tImage {
+  shared_ptr<tLoadedFile> pFile;
+  unsigned int index = 0;    // Index of the image in the file
+  unsigned int mipLevel = 0; // Only used for the mip ranges
+  string strFilePath;
+  unique_ptr<uint8_t[]> pPixels; // Or the palette indices
+  vector<uint8_t> palette;        // RGBA, only for the indexed images
+  unsigned int nbLevels = 1;      // From 'mipLevel', for the DDS and KTX2 files
+  vector<size_t> levelOffsets;    // Of the decoded levels in 'pPixels'
+  unsigned int width = 0;
+  unsigned int height = 0;
+  vector<uint8_t> encoded;
+};
+
+static bool isDXT(tBLPFormat format) {
+  switch (format) {
+  case BLP_FORMAT_DXT1_NO_ALPHA:
+  case BLP_FORMAT_DXT1_ALPHA_1:
+  case BLP_FORMAT_DXT3_ALPHA_4:
+  case BLP_FORMAT_DXT3_ALPHA_8:
+  case BLP_FORMAT_DXT5_ALPHA_8:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// Indices of a paletted mip level, with its palette in 'image.palette'.
+// Returns nullptr if the file isn't paletted, if its alpha values can't be
+// stored in the palette, or if the image is too small to benefit from it.
+static uint8_t *convertIndexed(const tLoadedFile &file, unsigned int mipLevel,
+                               tImage &image) {
+  switch (blp_format(file.blpInfos)) {
+  case BLP_FORMAT_PALETTED_NO_ALPHA:
+  case BLP_FORMAT_PALETTED_ALPHA_1:
+  case BLP_FORMAT_PALETTED_ALPHA_4:
+  case BLP_FORMAT_PALETTED_ALPHA_8:
+    break;
+
+  default:
+    return nullptr;
+  }
+
+  mipLevel = min(mipLevel, blp_nb_mip_levels(file.blpInfos) - 1);
+
+  unsigned int width = blp_width(file.blpInfos, mipLevel);
+  unsigned int height = blp_height(file.blpInfos, mipLevel);
+
+  unique_ptr<uint8_t[]> pIndices(new uint8_t[size_t(width) * height]);
+  image.palette.resize(256 * 4);
+
+  if (!blp_convert_indexed(file.pData, file.blpInfos, mipLevel,
+                           pIndices.get(), image.palette.data())) {
+    image.palette.clear();
+    return nullptr;
+  }
+
+  // Only the colors up to the last one used are written. The palette takes up
+  // to 4 bytes per color, so the smallest images are better stored as RGBA.
+  const size_t nbPixels = size_t(width) * height;
+  const unsigned int nbColors =
+      *max_element(pIndices.get(), pIndices.get() + nbPixels) + 1u;
+
+  if (nbPixels < nbColors * 4) {
+    image.palette.clear();
+    return nullptr;
+  }
+
+  image.palette.resize(nbColors * 4);
+  image.width = width;
+  image.height = height;
+  return pIndices.release();
+}
+
+// Prints the messages of a file in one go, and removes it if asked to
+static void reportFile(const string &strInFileName, tFileResult &result,
+                       const tConversionOptions &options, tResults &results) {
+  if (options.bRemove && result.bConverted)
+    remove(strInFileName.c_str());
+
+  lock_guard<mutex> lock(results.outputMutex);
+  cout << result.out.str() << flush;
+  cerr << result.err.str() << flush;
+}
+
+tLoadedFile::~tLoadedFile() {
+  pResult->bConverted = true;
+  for (const string &strError : errors) {
+    if (!strError.empty()) {
+      pResult->err << strError;
+      pResult->bConverted = false;
+    }
+  }
+
+  if (pResult->bConverted)
+    pResult->err << strInFileName << ": OK" << endl;
+
+  if (blpFile)
+    blp_close_file(blpFile);
+
+  reportFile(strInFileName, *pResult, *pOptions, *pResults);
+}
+
+static void appendToVector(void *context, void *data, int size) {
+  vector<uint8_t> *pBuffer = static_cast<vector<uint8_t> *>(context);
+  pBuffer->insert(pBuffer->end(), static_cast<uint8_t *>(data),
+                  static_cast<uint8_t *>(data) + size);
+}
+
+class tConversionPipeline {
+public:
+  // 'nbCPUThreads' of 0 means one per CPU core
+  tConversionPipeline(const tConversionOptions &options, tResults &results,
+                      unsigned int nbCPUThreads, unsigned int nbIOThreads,
+                      unsigned int depth)
+      : options(options), results(results), inputs(depth), toDecode(depth),
+        toEncode(depth), toWrite(depth), subtasks(256), nbPending(0),
+        bClosed(false) {
+    if (nbCPUThreads == 0)
+      nbCPUThreads = max(thread::hardware_concurrency(), 1u);
+
+    for (unsigned int i = 0; i < max(nbIOThreads, 1u); ++i)
+      threads.emplace_back(&tConversionPipeline::runIO, this);
+
+    for (unsigned int i = 0; i < nbCPUThreads; ++i)
+      threads.emplace_back(&tConversionPipeline::runCPU, this);
+  }
+
+  ~tConversionPipeline() { finish(); }
+
+  // Waits if the queue of the files is full
+  void add(const string &strInFileName, const string &strOutputFolder) {
+    tInput input;
+    input.strInFileName = strInFileName;
+    input.strOutputFolder = strOutputFolder;
+    input.pResult = results.add(strInFileName);
+
+    nbPending.fetch_add(1);
+
+    for (unsigned int i = 0; !inputs.tryPush(input); ++i)
+      backoff(i);
+  }
+
+  // Waits until all the files are converted
+  void finish() {
+    bClosed = true;
+
+    for (thread &thread : threads)
+      thread.join();
+
+    threads.clear();
+  }
+
+private:
+  static void backoff(unsigned int nbAttempts) {
+    if (nbAttempts < 16)
+      this_thread::yield();
+    else
+      this_thread::sleep_for(chrono::microseconds(nbAttempts < 64 ? 50 : 500));
+  }
+
+  bool isDone() const { return bClosed && (nbPending.load() == 0); }
+
+  void done() { nbPending.fetch_sub(1); }
+
+  // I/O threads: drain the written images first, so the memory is released
+  void runIO() {
+    unique_ptr<tImage> pImage;
+    tInput input;
+
+    for (unsigned int nbIdle = 0; !isDone();) {
+      if (toWrite.tryPop(pImage)) {
+        write(move(pImage));
+        nbIdle = 0;
+      } else if (inputs.tryPop(input)) {
+        read(input);
+        nbIdle = 0;
+      } else {
+        backoff(nbIdle++);
+      }
+    }
+  }
+
+  // Runs the tasks on the CPU threads which are idle, the calling one included.
+  // The tasks never wait, so the caller can run the ones of other images.
+  void parallelFor(unsigned int nbTasks,
+                   const function<void(unsigned int)> &task) {
+    atomic<unsigned int> nbDone(0);
+
+    for (unsigned int i = 0; i < nbTasks; ++i) {
+      function<void()> subtask = [&task, &nbDone, i]() {
+        task(i);
+        nbDone.fetch_add(1);
+      };
+
+      if (!subtasks.tryPush(subtask))
+        subtask();
+    }
+
+    function<void()> subtask;
+    for (unsigned int i = 0; nbDone.load() < nbTasks;) {
+      if (subtasks.tryPop(subtask))
+        subtask();
+      else
+        backoff(i++);
+    }
+  }
+
+  // CPU threads: also the stages closest to the output first
+  void runCPU() {
+    unique_ptr<tImage> pImage;
+    function<void()> subtask;
+
+    for (unsigned int nbIdle = 0; !isDone();) {
+      if (subtasks.tryPop(subtask)) {
+        subtask();
+        nbIdle = 0;
+      } else if (toEncode.tryPop(pImage)) {
+        encode(move(pImage));
+        nbIdle = 0;
+      } else if (toDecode.tryPop(pImage)) {
+        decode(move(pImage));
+        nbIdle = 0;
+      } else {
+        backoff(nbIdle++);
+      }
+    }
+  }
+
+  void read(tInput &input) {
+    tFileResult &result = *input.pResult;
+
+    if (options.bInfos) {
+      // Only the header is read from the file
+      tBLPInfos blpInfos = blp_probe_file(input.strInFileName.c_str());
+      if (blpInfos) {
+        showInfos(result.out, input.strInFileName, blpInfos);
+        blp_release(blpInfos);
+      } else {
+        result.err << "Failed to process the file '" << input.strInFileName
+                   << "'" << endl;
+      }
+
+      reportFile(input.strInFileName, result, options, results);
+      done();
+      return;
+    }
+
+    auto pFile = make_shared<tLoadedFile>();
+    pFile->strInFileName = input.strInFileName;
+    pFile->pResult = input.pResult;
+    pFile->pOptions = &options;
+    pFile->pResults = &results;
+
+    // The offsets of the mip levels are checked against the size of the file
+    pFile->blpFile = blp_open_file(input.strInFileName.c_str());
+    if (pFile->blpFile) {
+      pFile->pData = blp_file_buffer(pFile->blpFile);
+      pFile->blpInfos = blp_file_infos(pFile->blpFile);
+    }
+
+    if (!pFile->blpInfos) {
+      pFile->errors.push_back("Failed to process the file '" +
+                              input.strInFileName + "'\n");
+      done();
+      return;
+    }
+
+    string strOutFileName =
+        input.strInFileName.substr(0, input.strInFileName.size() - 4);
+
+    size_t offset = strOutFileName.find_last_of("/\\");
+    if (offset != string::npos)
+      strOutFileName = strOutFileName.substr(offset + 1);
+
+    string strPrefix = input.strOutputFolder + strOutFileName;
+
+    // One image per mip level of the range, or a single one
+    vector<unique_ptr<tImage>> images;
+
+    if (options.bContainer) {
+      if (!options.bMipRange ||
+          (options.firstMipLevel < blp_nb_mip_levels(pFile->blpInfos))) {
+        images.emplace_back(new tImage());
+        images.back()->strFilePath = strPrefix + "." + options.strFormat;
+      } else {
+        pFile->errors.push_back(input.strInFileName +
+                                ": No mip level in the requested range\n");
+      }
+    } else if (options.bMipRange && (options.thumbWidth == 0)) {
+      unsigned int nbMipLevels = blp_nb_mip_levels(pFile->blpInfos);
+
+      for (unsigned int mipLevel = options.firstMipLevel;
+           mipLevel <= min(options.lastMipLevel, nbMipLevels - 1);
+           ++mipLevel) {
+        images.emplace_back(new tImage());
+        images.back()->mipLevel = mipLevel;
+        images.back()->strFilePath = strPrefix + "_mip" + to_string(mipLevel) +
+                                     "." + options.strFormat;
+      }
+
+      if (images.empty())
+        pFile->errors.push_back(input.strInFileName +
+                                ": No mip level in the requested range\n");
+    } else {
+      images.emplace_back(new tImage());
+      images.back()->strFilePath = strPrefix + "." + options.strFormat;
+    }
+
+    pFile->errors.resize(max(pFile->errors.size(), images.size()));
+
+    // Only the mip levels needed by the images are loaded, by this I/O thread
+    // rather than by the CPU ones when decoding them
+    for (unsigned int i = 0; i < images.size(); ++i) {
+      images[i]->pFile = pFile;
+      images[i]->index = i;
+
+      unsigned int firstLevel, lastLevel, scale;
+      imageLevels(*images[i], firstLevel, lastLevel, scale);
+
+      for (unsigned int level = firstLevel; level <= lastLevel; ++level)
+        blp_prefetch_file(pFile->blpFile, level);
+    }
+
+    pFile = nullptr;
+
+    // The whole file is done once its images are
+    nbPending.fetch_add(unsigned(images.size()));
+    done();
+
+    // While the CPU threads are busy, make room for them by writing images
+    for (unique_ptr<tImage> &pImage : images) {
+      for (unsigned int i = 0; !toDecode.tryPush(pImage); ++i) {
+        unique_ptr<tImage> pOther;
+        if (toWrite.tryPop(pOther))
+          write(move(pOther));
+        else
+          backoff(i);
+      }
+    }
+  }
+
+  void decode(unique_ptr<tImage> pImage) {
+    tLoadedFile &file = *pImage->pFile;
+
+    if (!(options.bContainer ? decodeLevels(*pImage) : decodeImage(*pImage))) {
+      file.errors[pImage->index] =
+          file.strInFileName +
+          (options.bMipRange && !options.bContainer
+               ? ": mip level " + to_string(pImage->mipLevel)
+               : string()) +
+          ": Unsupported format\n";
+      done();
+      return;
+    }
+
+    // Encode the pending images while the next stage is full
+    for (unsigned int i = 0; !toEncode.tryPush(pImage); ++i) {
+      unique_ptr<tImage> pOther;
+      if (toEncode.tryPop(pOther))
+        encode(move(pOther));
+      else
+        backoff(i);
+    }
+  }
+
+  bool decodeImage(tImage &image) {
+    tLoadedFile &file = *image.pFile;
+    uint8_t *pPixels;
+
+    if (options.thumbWidth > 0) {
+      pPixels = blp_convert_thumbnail(
+          file.pData, file.blpInfos, options.thumbWidth, options.thumbHeight,
+          BLP_PIXEL_FORMAT_RGBA8, &image.width, &image.height);
+    } else {
+      unsigned int mipLevel, lastLevel, scale;
+      imageLevels(image, mipLevel, lastLevel, scale);
+
+      // The paletted images are written as indexed PNG files when possible,
+      // with a quarter of the data to compress
+      pPixels = nullptr;
+      if ((options.strFormat == "png") && (scale == 1))
+        pPixels = convertIndexed(file, mipLevel, image);
+
+      if (!pPixels)
+        pPixels = blp_convert_buffer_scaled(
+            file.pData, file.blpInfos, mipLevel, scale,
+            BLP_PIXEL_FORMAT_RGBA8, &image.width, &image.height);
+    }
+
+    image.pPixels.reset(pPixels);
+    return (pPixels != nullptr);
+  }
+
+  // The mip levels read from the file to produce an image, and the scale of
+  // the reduced JPEG decode of a single level. The containers hold the levels
+  // of the range, or from the requested one (the biggest one not bigger than
+  // --max-size) to the smallest one.
+  void imageLevels(const tImage &image, unsigned int &firstLevel,
+                   unsigned int &lastLevel, unsigned int &scale) const {
+    tBLPInfos blpInfos = image.pFile->blpInfos;
+    unsigned int nbMipLevels = blp_nb_mip_levels(blpInfos);
+    scale = 1;
+
+    if (options.bContainer) {
+      firstLevel = options.firstMipLevel;
+      lastLevel = nbMipLevels - 1;
+      if (options.bMipRange) {
+        lastLevel = min(options.lastMipLevel, lastLevel);
+      } else {
+        chooseResolution(blpInfos, options.maxSize, firstLevel, scale);
+        firstLevel = min(firstLevel, lastLevel);
+        scale = 1;
+      }
+    } else if (options.thumbWidth > 0) {
+      firstLevel = lastLevel = blp_thumbnail_mip_level(
+          blpInfos, options.thumbWidth, options.thumbHeight);
+    } else if (options.bMipRange) {
+      firstLevel = lastLevel = image.mipLevel;
+    } else {
+      firstLevel = options.firstMipLevel;
+      chooseResolution(blpInfos, options.maxSize, firstLevel, scale);
+      lastLevel = firstLevel;
+    }
+  }
+
+  // The DXT blocks don't need to be decoded, they are copied as they are in
+  // the file
+  bool decodeLevels(tImage &image) {
+    tLoadedFile &file = *image.pFile;
+
+    unsigned int firstLevel, lastLevel, scale;
+    imageLevels(image, firstLevel, lastLevel, scale);
+
+    image.mipLevel = firstLevel;
+    image.nbLevels = lastLevel - firstLevel + 1;
+    image.width = blp_width(file.blpInfos, firstLevel);
+    image.height = blp_height(file.blpInfos, firstLevel);
+
+    if (isDXT(blp_format(file.blpInfos)))
+      return true;
+
+    // The other formats are decoded as BGRA (DDS) or RGBA (KTX2)
+    const tBLPPixelFormat format =
+        (options.strFormat == "dds" ? BLP_PIXEL_FORMAT_BGRA8
+                                    : BLP_PIXEL_FORMAT_RGBA8);
+
+    image.levelOffsets.assign(1, 0);
+    for (unsigned int level = firstLevel; level <= lastLevel; ++level)
+      image.levelOffsets.push_back(image.levelOffsets.back() +
+                                   blp_required_size(file.blpInfos, level,
+                                                     format));
+
+    image.pPixels.reset(new uint8_t[image.levelOffsets.back()]);
+
+    for (unsigned int i = 0; i < image.nbLevels; ++i) {
+      if (!blp_convert_into(file.pData, file.blpInfos, firstLevel + i,
+                            image.pPixels.get() + image.levelOffsets[i],
+                            blp_width(file.blpInfos, firstLevel + i) * 4,
+                            format)) {
+        image.pPixels.reset();
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void encode(unique_ptr<tImage> pImage) {
+    int success;
+    if (options.strFormat == "tga")
+      success = stbi_write_tga_to_func(appendToVector, &pImage->encoded,
+                                       pImage->width, pImage->height, 4,
+                                       pImage->pPixels.get());
+    else if (options.strFormat == "dds")
+      success = encodeDDS(*pImage);
+    else if (options.strFormat == "ktx2")
+      success = encodeKTX2(*pImage);
+    else
+      success = encodePNG(*pImage);
+
+    pImage->pPixels.reset();
+
+    if (!success) {
+      pImage->pFile->errors[pImage->index] =
+          pImage->pFile->strInFileName + ": Failed to encode the image\n";
+      done();
+      return;
+    }
+
+    // The I/O threads are the only consumers of the written images
+    for (unsigned int i = 0; !toWrite.tryPush(pImage); ++i)
+      backoff(i);
+  }
+
+  bool encodePNG(tImage &image) {
+    tParallelFor parallel = [this](unsigned int nbTasks,
+                                   const function<void(unsigned int)> &task) {
+      parallelFor(nbTasks, task);
+    };
+
+    if (image.palette.empty())
+      return pngEncode(image.pPixels.get(), image.width, image.height,
+                       options.png, image.encoded, parallel);
+
+    return pngEncodeIndexed(image.pPixels.get(), image.width, image.height,
+                            image.palette.data(),
+                            unsigned(image.palette.size() / 4), options.png,
+                            image.encoded, parallel);
+  }
+
+  // The decoded pixels or the blocks in the file of a level of the image
+  static const uint8_t *levelData(const tImage &image, unsigned int index,
+                                  size_t &size) {
+    if (image.pPixels) {
+      size = image.levelOffsets[index + 1] - image.levelOffsets[index];
+      return image.pPixels.get() + image.levelOffsets[index];
+    }
+
+    return blp_mip_data(image.pFile->pData, image.pFile->blpInfos,
+                        image.mipLevel + index, &size);
+  }
+
+  bool encodeDDS(tImage &image) {
+    vector<tDDSLevel> levels(image.nbLevels);
+    for (unsigned int i = 0; i < image.nbLevels; ++i)
+      levels[i].pData = levelData(image, i, levels[i].size);
+
+    tDDSFormat format;
+    switch (image.pPixels ? BLP_FORMAT_RAW_BGRA
+                          : blp_format(image.pFile->blpInfos)) {
+    case BLP_FORMAT_DXT1_NO_ALPHA:
+    case BLP_FORMAT_DXT1_ALPHA_1:
+      format = DDS_FORMAT_DXT1;
+      break;
+
+    case BLP_FORMAT_DXT3_ALPHA_4:
+    case BLP_FORMAT_DXT3_ALPHA_8:
+      format = DDS_FORMAT_DXT3;
+      break;
+
+    case BLP_FORMAT_DXT5_ALPHA_8:
+      format = DDS_FORMAT_DXT5;
+      break;
+
+    default:
+      format = DDS_FORMAT_BGRA8;
+      break;
+    }
+
+    return ddsEncode(format, image.width, image.height, levels, image.encoded);
+  }
+
+  bool encodeKTX2(tImage &image) {
+    vector<tKTX2Level> levels(image.nbLevels);
+    for (unsigned int i = 0; i < image.nbLevels; ++i)
+      levels[i].pData = levelData(image, i, levels[i].size);
+
+    tKTX2Format format;
+    switch (image.pPixels ? BLP_FORMAT_RAW_BGRA
+                          : blp_format(image.pFile->blpInfos)) {
+    case BLP_FORMAT_DXT1_NO_ALPHA:
+      format = KTX2_FORMAT_BC1_RGB;
+      break;
+
+    case BLP_FORMAT_DXT1_ALPHA_1:
+      format = KTX2_FORMAT_BC1_RGBA;
+      break;
+
+    case BLP_FORMAT_DXT3_ALPHA_4:
+    case BLP_FORMAT_DXT3_ALPHA_8:
+      format = KTX2_FORMAT_BC2;
+      break;
+
+    case BLP_FORMAT_DXT5_ALPHA_8:
+      format = KTX2_FORMAT_BC3;
+      break;
+
+    default:
+      format = KTX2_FORMAT_RGBA8;
+      break;
+    }
+
+    return ktx2Encode(format, image.width, image.height, levels,
+                      image.encoded);
+  }
+
+  void write(unique_ptr<tImage> pImage) {
+    FILE *pFile = fopen(pImage->strFilePath.c_str(), "wb");
+
+    bool bSuccess = (pFile != nullptr);
+    if (pFile) {
+      bSuccess = (fwrite(pImage->encoded.data(), 1, pImage->encoded.size(),
+                         pFile) == pImage->encoded.size());
+      bSuccess = (fclose(pFile) == 0) && bSuccess;
+    }
+
+    if (!bSuccess)
+      pImage->pFile->errors[pImage->index] = pImage->pFile->strInFileName +
+                                             ": Failed to write '" +
+                                             pImage->strFilePath + "'\n";
+
+    // Releases the file with its last image
+    pImage = nullptr;
+    done();
+  }
+
+  const tConversionOptions &options;
+  tResults &results;
+
+  tBoundedQueue<tInput> inputs;
+  tBoundedQueue<unique_ptr<tImage>> toDecode;
+  tBoundedQueue<unique_ptr<tImage>> toEncode;
+  tBoundedQueue<unique_ptr<tImage>> toWrite;
+  tBoundedQueue<function<void()>> subtasks; // Parts of an image
+
+  atomic<unsigned int> nbPending; // Files and images not done yet
+  atomic<bool> bClosed;           // No more files will be added
+  vector<thread> threads;
+};
+
+static bool isBLPFile(const string &strFileName) {
+  if (strFileName.size() <= 4)
+    return false;
+
+  string strExtension = strFileName.substr(strFileName.size() - 4);
+  transform(strExtension.begin(), strExtension.end(), strExtension.begin(),
+            ::tolower);
+  return strExtension == ".blp";
+}
+
+// Submits one task per subfolder, so the folders are walked in parallel, and
+// adds the BLP files to the pipeline
+static void processFolder(tThreadPool &pool, tConversionPipeline &pipeline,
+                          const string &strFolder,
+                          const string &strOutputFolder,
+                          const tConversionOptions &options,
+                          tResults &results) {
+  vector<string> files;
+  vector<string> folders;
+
+  if (!listFolder(strFolder, files, folders)) {
+    lock_guard<mutex> lock(results.outputMutex);
+    cerr << "Failed to read the folder '" << strFolder << "'" << endl;
+    return;
+  }
+
+  if (!options.bInfos && !makeFolders(strOutputFolder)) {
+    lock_guard<mutex> lock(results.outputMutex);
+    cerr << "Failed to create the folder '" << strOutputFolder << "'" << endl;
+    return;
+  }
+
+  for (const string &strName : folders) {
+    string strSubFolder = strFolder + strName + "/";
+    string strSubOutputFolder = strOutputFolder + strName + "/";
+
+    pool.submit([=, &pool, &pipeline, &options, &results]() {
+      processFolder(pool, pipeline, strSubFolder, strSubOutputFolder, options,
+                    results);
+    });
+  }
+
+  for (const string &strName : files) {
+    if (isBLPFile(strName))
+      pipeline.add(strFolder + strName, strOutputFolder);
+  }
+}
+
+// Encodes an image file as a BLP file in the destination folder
+static void encodeFile(const string &strInFileName,
+                       const tConversionOptions &options, tResults &results) {
+  tFileResult &result = *results.add(strInFileName);
+
+  string strOutFileName = strInFileName;
+
+  size_t offset = strOutFileName.find_last_of("/\\");
+  if (offset != string::npos)
+    strOutFileName = strOutFileName.substr(offset + 1);
+
+  offset = strOutFileName.find_last_of('.');
+  if ((offset != string::npos) && (offset > 0))
+    strOutFileName = strOutFileName.substr(0, offset);
+
+  string strOutPath = options.strOutputFolder + strOutFileName + ".blp";
+
+  tBLPEncodeStats stats;
+
+  if (blp_encode_file(strInFileName.c_str(), strOutPath.c_str(), options.blp,
+                      &stats)) {
+    // Same stream as the conversions
+    result.err << strInFileName << ": OK (PSNR: " << fixed << setprecision(2)
+               << stats.psnr << " dB, "
+               << (unsigned long)(stats.nbBlocks / max(stats.seconds, 1e-6))
+               << " blocks/s per thread";
+
+    if (options.blp.quality == BLP_QUALITY_ADAPTIVE)
+      result.err << ", " << stats.nbRangeFitBlocks << "/" << stats.nbBlocks
+                 << " with the range fit";
+
+    result.err << ")" << endl;
+    result.bConverted = true;
+  } else {
+    result.err << strInFileName << ": Failed to encode '" << strOutPath
+               << "'" << endl;
+  }
+
+  reportFile(strInFileName, result, options, results);
+}
+
+int main(int argc, char **argv) {
+  tConversionOptions options;
+  string strRecursiveFolder;
+  bool bDestGiven = false;
+  unsigned int nbJobs = 1;
+  bool bJobsGiven = false;
+  unsigned int nbIOThreads = 2;
+  unsigned int queueDepth = 16;
   unsigned int nbImagesTotal = 0;
   unsigned int nbImagesConverted = 0;
 
@@ -104,23 +1049,128 @@ int main(int argc, char **argv) {
         return 0;
 
       case OPT_INFOS:
-        bInfos = true;
+        options.bInfos = true;
         break;
 
       case OPT_DEST:
-        strOutputFolder = args.OptionArg();
-        if (strOutputFolder.at(strOutputFolder.size() - 1) != '/')
-          strOutputFolder += "/";
+        options.strOutputFolder = args.OptionArg();
+        if (options.strOutputFolder.at(options.strOutputFolder.size() - 1) !=
+            '/')
+          options.strOutputFolder += "/";
+        bDestGiven = true;
         break;
 
       case OPT_FORMAT:
-        strFormat = args.OptionArg();
-        if (strFormat != "tga")
-          strFormat = "png";
+        options.strFormat = args.OptionArg();
+        if ((options.strFormat != "tga") && (options.strFormat != "dds") &&
+            (options.strFormat != "ktx2"))
+          options.strFormat = "png";
+
+        options.bContainer =
+            (options.strFormat == "dds") || (options.strFormat == "ktx2");
         break;
 
       case OPT_MIP_LEVEL:
-        mipLevel = atoi(args.OptionArg());
+        if (!parseMipLevels(args.OptionArg(), options)) {
+          cerr << "Invalid mip level(s): " << args.OptionArg() << endl;
+          return -1;
+        }
+        break;
+
+      case OPT_JOBS:
+        nbJobs = atoi(args.OptionArg());
+        bJobsGiven = true;
+        break;
+
+      case OPT_MAX_SIZE:
+        options.maxSize = atoi(args.OptionArg());
+        break;
+
+      case OPT_THUMBNAIL:
+        if ((sscanf(args.OptionArg(), "%ux%u", &options.thumbWidth,
+                    &options.thumbHeight) != 2) ||
+            (options.thumbWidth == 0) || (options.thumbHeight == 0)) {
+          cerr << "Invalid thumbnail size: " << args.OptionArg() << endl;
+          return -1;
+        }
+        break;
+
+      case OPT_RECURSIVE:
+        strRecursiveFolder = args.OptionArg();
+        if (strRecursiveFolder.at(strRecursiveFolder.size() - 1) != '/')
+          strRecursiveFolder += "/";
+        break;
+
+      case OPT_REMOVE:
+        options.bRemove = true;
+        break;
+
+      case OPT_IO_THREADS:
+        nbIOThreads = max(atoi(args.OptionArg()), 1);
+        break;
+
+      case OPT_QUEUE_DEPTH:
+        queueDepth = max(atoi(args.OptionArg()), 1);
+        break;
+
+      case OPT_PNG_LEVEL:
+        options.png.level = min(max(atoi(args.OptionArg()), 0), 9);
+        break;
+
+      case OPT_PNG_FAST:
+        options.png.bFastFilters = true;
+        break;
+
+      case OPT_TO_BLP:
+        options.bToBLP = true;
+        break;
+
+      case OPT_DXT1:
+        options.blp.format = BLP_FORMAT_DXT1_ALPHA_1;
+        break;
+
+      case OPT_DXT3:
+        options.blp.format = BLP_FORMAT_DXT3_ALPHA_8;
+        break;
+
+      case OPT_DXT5:
+        options.blp.format = BLP_FORMAT_DXT5_ALPHA_8;
+        break;
+
+      case OPT_MIP_FILTER: {
+        const string strFilter = args.OptionArg();
+        if (strFilter == "triangle")
+          options.blp.mipFilter = BLP_MIP_FILTER_TRIANGLE;
+        else if (strFilter == "kaiser")
+          options.blp.mipFilter = BLP_MIP_FILTER_KAISER;
+        else
+          options.blp.mipFilter = BLP_MIP_FILTER_BOX;
+        break;
+      }
+
+      case OPT_LINEAR:
+        options.blp.bSRGB = false;
+        break;
+
+      case OPT_QUALITY: {
+        const string strQuality = args.OptionArg();
+        if (strQuality == "fast")
+          options.blp.quality = BLP_QUALITY_FAST;
+        else if (strQuality == "best")
+          options.blp.quality = BLP_QUALITY_BEST;
+        else if (strQuality == "adaptive")
+          options.blp.quality = BLP_QUALITY_ADAPTIVE;
+        else
+          options.blp.quality = BLP_QUALITY_NORMAL;
+        break;
+      }
+
+      case OPT_UNIFORM_METRIC:
+        options.blp.bPerceptualMetric = false;
+        break;
+
+      case OPT_WEIGHT_BY_ALPHA:
+        options.blp.bWeightColorByAlpha = true;
         break;
       }
     } else {
@@ -129,96 +1179,89 @@ int main(int argc, char **argv) {
     }
   }
 
-  if (args.FileCount() == 0) {
-    cerr << "No BLP file specified" << endl;
+  if (options.bContainer && (options.thumbWidth > 0)) {
+    cerr << "The thumbnails can't be written in DDS or KTX2 files" << endl;
+    return -1;
+  }
+
+  if (options.bToBLP && !strRecursiveFolder.empty()) {
+    cerr << "Only the given image files can be encoded as BLP files" << endl;
+    return -1;
+  }
+
+  // The images given to --to-blp are the sources of the BLP files
+  if (options.bToBLP && options.bRemove) {
+    cerr << "The image files encoded as BLP files can't be removed" << endl;
+    return -1;
+  }
+
+  if ((args.FileCount() == 0) && strRecursiveFolder.empty()) {
+    cerr << (options.bToBLP ? "No image file specified"
+                            : "No BLP file specified")
+         << endl;
     return -1;
   }
 
   // Process the files
-  for (int i = 0; i < args.FileCount(); ++i) {
-    ++nbImagesTotal;
+  tResults results;
 
-    string strInFileName = args.File(i);
-    string strOutFileName =
-        strInFileName.substr(0, strInFileName.size() - 3) + strFormat;
+  if (options.bToBLP) {
+    // One file at a time, each one compressed by all the threads
+    options.blp.nbThreads = (bJobsGiven ? nbJobs : 0);
 
-    size_t offset = strOutFileName.find_last_of("/\\");
-    if (offset != string::npos)
-      strOutFileName = strOutFileName.substr(offset + 1);
+    for (int i = 0; i < args.FileCount(); ++i)
+      encodeFile(args.File(i), options, results);
+  } else {
+    tConversionPipeline pipeline(options, results, nbJobs, nbIOThreads,
+                                 queueDepth);
 
-    FILE *pFile = fopen(strInFileName.c_str(), "rb");
-    if (!pFile) {
-      cerr << "Failed to open the file '" << strInFileName << "'" << endl;
-      continue;
-    }
-
-    fseek(pFile, 0, SEEK_END);
-    auto size = ftell(pFile);
-    fseek(pFile, 0, SEEK_SET);
-
-    std::vector<char> buffer(size);
-    fread(buffer.data(), 1, size, pFile);
-
-    tBLPInfos blpInfos = blp_process_buffer(buffer.data());
-    if (!blpInfos) {
-      cerr << "Failed to process the file '" << strInFileName << "'" << endl;
-      fclose(pFile);
-      continue;
-    }
-
-    if (!bInfos) {
-      tBGRAPixel *pData = blp_convert_buffer(buffer.data(), blpInfos, mipLevel);
-      if (pData) {
-        unsigned int width = blp_width(blpInfos, mipLevel);
-        unsigned int height = blp_height(blpInfos, mipLevel);
-
-        // Allocate buffer for image data in RGBA format
-        vector<uint8_t> imageData(width * height * 4); // RGBA
-
-        // Convert BGRAPixel to RGBA format
-        for (unsigned int y = 0; y < height; ++y) {
-          for (unsigned int x = 0; x < width; ++x) {
-            tBGRAPixel *srcPixel = pData + (height - 1 - y) * width + x;
-            uint8_t *destPixel = imageData.data() + (y * width + x) * 4;
-            destPixel[0] = srcPixel->r; // R
-            destPixel[1] = srcPixel->g; // G
-            destPixel[2] = srcPixel->b; // B
-            destPixel[3] = srcPixel->a; // A
-          }
-        }
+    for (int i = 0; i < args.FileCount(); ++i)
+      pipeline.add(args.File(i), options.strOutputFolder);
 
-        // Flip the image vertically
-        flipImageVertically(imageData.data(), width, height, 4);
+    // Without destination, the images are written next to the BLP files
+    if (!strRecursiveFolder.empty()) {
+      string strOutputFolder =
+          (bDestGiven ? options.strOutputFolder : strRecursiveFolder);
 
-        // Define file path
-        string filePath = strOutputFolder + strOutFileName;
+      tThreadPool pool(nbIOThreads);
+      pool.submit([=, &pool, &pipeline, &options, &results]() {
+        processFolder(pool, pipeline, strRecursiveFolder, strOutputFolder,
+                      options, results);
+      });
+    }
 
-        // Save image
-        if (strFormat == "tga") {
-          stbi_write_tga(filePath.c_str(), width, height, 4, imageData.data());
-        } else if (strFormat == "png") {
-          stbi_write_png(filePath.c_str(), width, height, 4, imageData.data(),
-                         width * 4);
-        } else {
-          cerr << strInFileName << ": Unsupported format" << endl;
-        }
+    pipeline.finish();
+  }
 
-        // Log success
-        cerr << strInFileName << ": OK" << endl;
+  if (!options.bInfos) {
+    for (const tFileResult &result : results.files) {
+      ++nbImagesTotal;
+      if (result.bConverted)
         ++nbImagesConverted;
+    }
 
-        // Free allocated memory
-        delete[] pData;
-      } else {
-        cerr << strInFileName << ": Unsupported format" << endl;
+    cout << endl << nbImagesConverted << " images converted";
+    if (nbImagesConverted < nbImagesTotal) {
+      cout << ", " << (nbImagesTotal - nbImagesConverted)
+           << " images not converted" << endl
+           << endl
+           << "Images not converted:" << endl;
+
+      // Sorted, since the files are processed in an order depending on the
+      // threads
+      vector<string> failed;
+      for (const tFileResult &result : results.files) {
+        if (!result.bConverted)
+          failed.push_back(result.strFileName);
       }
-    } else {
-      showInfos(args.File(i), blpInfos);
-    }
 
-    fclose(pFile);
+      sort(failed.begin(), failed.end());
 
-    blp_release(blpInfos);
+      for (const string &strFileName : failed)
+        cout << "    * " << strFileName << endl;
+    } else {
+      cout << endl;
+    }
   }
 
   return 0;
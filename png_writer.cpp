@@ -0,0 +1,424 @@
+#include "png_writer.h"
+
+// The filters, the compressor and the CRC of stb_image_write are reused
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+// Size of the filtered data of a band, compressed independently of the others
+static const size_t BAND_SIZE = 256 * 1024;
+
+// Length of the hash chains of the compressor of stb_image_write for each level (8 by default),
+// strictly increasing so each level is a different trade-off
+static const int QUALITIES[] = { 0, 2, 3, 4, 5, 6, 8, 12, 16, 32 };
+
+static const uint32_t ADLER_BASE = 65521;
+
+
+static uint32_t adler32(const uint8_t* pData, size_t size)
+{
+    uint32_t s1 = 1;
+    uint32_t s2 = 0;
+
+    while (size > 0)
+    {
+        // The biggest block which can't overflow the sums
+        size_t blockSize = std::min(size, size_t(5552));
+        size -= blockSize;
+
+        for (size_t i = 0; i < blockSize; ++i)
+        {
+            s1 += pData[i];
+            s2 += s1;
+        }
+
+        pData += blockSize;
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+    }
+
+    return (s2 << 16) | s1;
+}
+
+
+// Adler32 of the concatenation of two buffers, from their own adler32 (same as zlib's one)
+static uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    uint32_t rem = uint32_t(size2 % ADLER_BASE);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = (rem * sum1) % ADLER_BASE;
+
+    sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum1 >= ADLER_BASE)
+        sum1 -= ADLER_BASE;
+    if (sum2 >= (ADLER_BASE << 1))
+        sum2 -= (ADLER_BASE << 1);
+    if (sum2 >= ADLER_BASE)
+        sum2 -= ADLER_BASE;
+
+    return (sum2 << 16) | sum1;
+}
+
+
+// Filters a row of 'bytesPerPixel' bytes pixels, with the same filters than stbi_write_png()
+static void filterRow(const uint8_t* pPixels, unsigned int width, unsigned int height, unsigned int bytesPerPixel,
+                      unsigned int y, bool bFastFilters, uint8_t* pDst, signed char* pBuffer)
+{
+    const int rowSize = int(width * bytesPerPixel);
+    unsigned char* pRows = const_cast<unsigned char*>(pPixels);
+
+    // The palette indices aren't filtered, the differences between them being meaningless (as
+    // recommended by the PNG specification)
+    if (bytesPerPixel == 1)
+    {
+        pDst[0] = 0;
+        memcpy(pDst + 1, pPixels + size_t(y) * width, width);
+        return;
+    }
+
+    // Estimate the best filter, the one giving the smallest values
+    static const int ALL_FILTERS[] = { 0, 1, 2, 3, 4 };
+    static const int FAST_FILTERS[] = { 1, 2 };
+
+    const int* filters = (bFastFilters ? FAST_FILTERS : ALL_FILTERS);
+    const int nbFilters = (bFastFilters ? 2 : 5);
+
+    int bestFilter = 0;
+    int bestEstimation = 0x7FFFFFFF;
+
+    for (int i = 0; i < nbFilters; ++i)
+    {
+        stbiw__encode_png_line(pRows, rowSize, int(width), int(height), int(y), int(bytesPerPixel), filters[i],
+                               pBuffer);
+
+        int estimation = 0;
+        for (int j = 0; j < rowSize; ++j)
+            estimation += abs(pBuffer[j]);
+
+        if (estimation < bestEstimation)
+        {
+            bestEstimation = estimation;
+            bestFilter = filters[i];
+        }
+    }
+
+    if (bestFilter != filters[nbFilters - 1])
+    {
+        stbiw__encode_png_line(pRows, rowSize, int(width), int(height), int(y), int(bytesPerPixel), bestFilter,
+                               pBuffer);
+    }
+
+    pDst[0] = uint8_t(bestFilter);
+    memcpy(pDst + 1, pBuffer, size_t(rowSize));
+}
+
+
+// Stored blocks (BFINAL = 0, BTYPE = 0, LEN and NLEN, then the data)
+static void storeBand(const uint8_t* pData, size_t size, std::vector<uint8_t>& deflate)
+{
+    for (size_t offset = 0; offset < size; offset += 65535)
+    {
+        size_t blockSize = std::min(size - offset, size_t(65535));
+        const uint8_t header[] = { 0, uint8_t(blockSize), uint8_t(blockSize >> 8), uint8_t(~blockSize),
+                                   uint8_t(~blockSize >> 8) };
+
+        deflate.insert(deflate.end(), header, header + 5);
+        deflate.insert(deflate.end(), pData + offset, pData + offset + blockSize);
+    }
+}
+
+
+// Same as stbi_zlib_compress(), but produces a raw deflate block which isn't the final one and
+// ends with a sync flush (an empty stored block, so the next one starts on a byte boundary)
+static bool deflateBand(unsigned char* data, int data_len, int quality, std::vector<uint8_t>& deflate)
+{
+    static unsigned short lengthc[] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258, 259 };
+    static unsigned char  lengtheb[]= { 0,0,0,0,0,0,0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,  4,  5,  5,  5,  5,  0 };
+    static unsigned short distc[]   = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
+    static unsigned char  disteb[]  = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+    unsigned int bitbuf = 0;
+    int i, j, bitcount = 0;
+    unsigned char* out = nullptr;
+    unsigned char*** hash_table = (unsigned char***) STBIW_MALLOC(stbiw__ZHASH * sizeof(unsigned char**));
+    if (!hash_table)
+        return false;
+
+    stbiw__zlib_add(0, 1);  // BFINAL = 0
+    stbiw__zlib_add(1, 2);  // BTYPE = 1 -- fixed huffman
+
+    for (i = 0; i < stbiw__ZHASH; ++i)
+        hash_table[i] = nullptr;
+
+    i = 0;
+    while (i < data_len - 3)
+    {
+        // Hash next 3 bytes of data to be compressed
+        int h = stbiw__zhash(data + i) & (stbiw__ZHASH - 1), best = 3;
+        unsigned char* bestloc = 0;
+        unsigned char** hlist = hash_table[h];
+        int n = stbiw__sbcount(hlist);
+        for (j = 0; j < n; ++j)
+        {
+            if (hlist[j] - data > i - 32768)
+            {
+                int d = stbiw__zlib_countm(hlist[j], data + i, data_len - i);
+                if (d >= best) { best = d; bestloc = hlist[j]; }
+            }
+        }
+
+        // When hash table entry is too long, delete half the entries
+        if (hash_table[h] && stbiw__sbn(hash_table[h]) == 2 * quality)
+        {
+            STBIW_MEMMOVE(hash_table[h], hash_table[h] + quality, sizeof(hash_table[h][0]) * quality);
+            stbiw__sbn(hash_table[h]) = quality;
+        }
+        stbiw__sbpush(hash_table[h], data + i);
+
+        if (bestloc)
+        {
+            // "Lazy matching": check match at *next* byte, and if it's better, do cur byte as literal
+            h = stbiw__zhash(data + i + 1) & (stbiw__ZHASH - 1);
+            hlist = hash_table[h];
+            n = stbiw__sbcount(hlist);
+            for (j = 0; j < n; ++j)
+            {
+                if (hlist[j] - data > i - 32767)
+                {
+                    int e = stbiw__zlib_countm(hlist[j], data + i + 1, data_len - i - 1);
+                    if (e > best) { bestloc = nullptr; break; }
+                }
+            }
+        }
+
+        if (bestloc)
+        {
+            int d = (int) (data + i - bestloc); // Distance back
+            for (j = 0; best > lengthc[j + 1] - 1; ++j);
+            stbiw__zlib_huff(j + 257);
+            if (lengtheb[j]) stbiw__zlib_add(best - lengthc[j], lengtheb[j]);
+            for (j = 0; d > distc[j + 1] - 1; ++j);
+            stbiw__zlib_add(stbiw__zlib_bitrev(j, 5), 5);
+            if (disteb[j]) stbiw__zlib_add(d - distc[j], disteb[j]);
+            i += best;
+        }
+        else
+        {
+            stbiw__zlib_huffb(data[i]);
+            ++i;
+        }
+    }
+
+    // Write out final bytes
+    for (; i < data_len; ++i)
+        stbiw__zlib_huffb(data[i]);
+    stbiw__zlib_huff(256); // End of block
+
+    // Sync flush: header of an empty stored block, padding to a byte boundary, LEN and NLEN
+    stbiw__zlib_add(0, 3);
+    while (bitcount)
+        stbiw__zlib_add(0, 1);
+
+    for (i = 0; i < stbiw__ZHASH; ++i)
+        (void) stbiw__sbfree(hash_table[i]);
+    STBIW_FREE(hash_table);
+
+    const uint8_t sync[] = { 0x00, 0x00, 0xFF, 0xFF };
+    deflate.assign(out, out + stbiw__sbn(out));
+    deflate.insert(deflate.end(), sync, sync + 4);
+    (void) stbiw__sbfree(out);
+
+    // Store uncompressed instead if compression was worse (the stored blocks being byte-aligned,
+    // they don't need the sync flush)
+    if (deflate.size() > size_t(data_len) + ((data_len + 65534) / 65535) * 5)
+    {
+        deflate.clear();
+        storeBand(data, size_t(data_len), deflate);
+    }
+
+    return true;
+}
+
+
+// A band of rows, compressed as raw deflate blocks ending on a byte boundary (never final)
+struct tBand
+{
+    std::vector<uint8_t>    deflate;
+    uint32_t                adler;
+    size_t                  size;       // Of the filtered data
+};
+
+
+static bool compressBand(const uint8_t* pPixels, unsigned int width, unsigned int height, unsigned int bytesPerPixel,
+                         unsigned int firstRow, unsigned int nbRows, const tPNGOptions& options, tBand& band)
+{
+    const size_t filteredRowSize = size_t(width) * bytesPerPixel + 1;
+
+    std::vector<uint8_t> filtered(filteredRowSize * nbRows);
+    std::vector<signed char> buffer(width * bytesPerPixel);
+
+    for (unsigned int y = 0; y < nbRows; ++y)
+    {
+        filterRow(pPixels, width, height, bytesPerPixel, firstRow + y, options.bFastFilters,
+                  &filtered[y * filteredRowSize], buffer.data());
+    }
+
+    band.size = filtered.size();
+    band.adler = adler32(filtered.data(), filtered.size());
+
+    if (options.level == 0)
+    {
+        storeBand(filtered.data(), filtered.size(), band.deflate);
+        return true;
+    }
+
+    return deflateBand(filtered.data(), int(filtered.size()), QUALITIES[std::min(options.level, 9u)], band.deflate);
+}
+
+
+static void appendUInt32(std::vector<uint8_t>& data, uint32_t value)
+{
+    const uint8_t bytes[] = { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+    data.insert(data.end(), bytes, bytes + 4);
+}
+
+
+static void appendChunk(std::vector<uint8_t>& png, const char* type, const uint8_t* pData, size_t size)
+{
+    appendUInt32(png, uint32_t(size));
+
+    const size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), pData, pData + size);
+
+    appendUInt32(png, stbiw__crc32(&png[start], int(size + 4)));
+}
+
+
+// Compressed data of the image (the content of the IDAT chunk)
+static bool compressImage(const uint8_t* pPixels, unsigned int width, unsigned int height, unsigned int bytesPerPixel,
+                          const tPNGOptions& options, const tParallelFor& parallelFor, std::vector<uint8_t>& zlib)
+{
+    // Split the rows into bands
+    const unsigned int rowsPerBand = unsigned(std::max(BAND_SIZE / (size_t(width) * bytesPerPixel + 1), size_t(1)));
+    const unsigned int nbBands = (height + rowsPerBand - 1) / rowsPerBand;
+
+    std::vector<tBand> bands(nbBands);
+    std::vector<char> success(nbBands, 0);
+
+    auto compress = [&](unsigned int index) {
+        unsigned int firstRow = index * rowsPerBand;
+        success[index] = compressBand(pPixels, width, height, bytesPerPixel, firstRow,
+                                      std::min(rowsPerBand, height - firstRow), options, bands[index]);
+    };
+
+    if (parallelFor && (nbBands > 1))
+    {
+        parallelFor(nbBands, compress);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < nbBands; ++i)
+            compress(i);
+    }
+
+    if (std::find(success.begin(), success.end(), 0) != success.end())
+        return false;
+
+    // zlib stream: header, the bands, an empty final block and the adler32 of everything
+    zlib = { 0x78, 0x5E };
+    uint32_t adler = 1;
+
+    for (const tBand& band : bands)
+    {
+        zlib.insert(zlib.end(), band.deflate.begin(), band.deflate.end());
+        adler = adler32Combine(adler, band.adler, band.size);
+    }
+
+    zlib.push_back(0x03);
+    zlib.push_back(0x00);
+    appendUInt32(zlib, adler);
+
+    return true;
+}
+
+
+// Signature and IHDR chunk (8 bits per channel, no interlacing)
+static void startPNG(unsigned int width, unsigned int height, uint8_t colorType, size_t reserve,
+                     std::vector<uint8_t>& png)
+{
+    const uint8_t header[] = { uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+                               uint8_t(height >> 24), uint8_t(height >> 16), uint8_t(height >> 8), uint8_t(height),
+                               8, colorType, 0, 0, 0 };
+    const uint8_t signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+    png.clear();
+    png.reserve(reserve + 64);
+    png.insert(png.end(), signature, signature + 8);
+
+    appendChunk(png, "IHDR", header, sizeof(header));
+}
+
+
+bool pngEncode(const uint8_t* pPixels, unsigned int width, unsigned int height, const tPNGOptions& options,
+               std::vector<uint8_t>& png, const tParallelFor& parallelFor)
+{
+    if ((width == 0) || (height == 0))
+        return false;
+
+    std::vector<uint8_t> zlib;
+    if (!compressImage(pPixels, width, height, 4, options, parallelFor, zlib))
+        return false;
+
+    startPNG(width, height, 6, zlib.size(), png);
+    appendChunk(png, "IDAT", zlib.data(), zlib.size());
+    appendChunk(png, "IEND", nullptr, 0);
+
+    return true;
+}
+
+
+bool pngEncodeIndexed(const uint8_t* pIndices, unsigned int width, unsigned int height, const uint8_t* pPalette,
+                      unsigned int nbColors, const tPNGOptions& options, std::vector<uint8_t>& png,
+                      const tParallelFor& parallelFor)
+{
+    if ((width == 0) || (height == 0) || (nbColors == 0) || (nbColors > 256))
+        return false;
+
+    std::vector<uint8_t> zlib;
+    if (!compressImage(pIndices, width, height, 1, options, parallelFor, zlib))
+        return false;
+
+    // PLTE: the RGB values, tRNS: the alpha values up to the last color which isn't opaque
+    uint8_t colors[256 * 3];
+    uint8_t alphas[256];
+    unsigned int nbAlphas = 0;
+
+    for (unsigned int i = 0; i < nbColors; ++i)
+    {
+        memcpy(&colors[i * 3], &pPalette[i * 4], 3);
+        alphas[i] = pPalette[i * 4 + 3];
+
+        if (alphas[i] != 0xFF)
+            nbAlphas = i + 1;
+    }
+
+    startPNG(width, height, 3, zlib.size(), png);
+    appendChunk(png, "PLTE", colors, nbColors * 3);
+
+    if (nbAlphas > 0)
+        appendChunk(png, "tRNS", alphas, nbAlphas);
+
+    appendChunk(png, "IDAT", zlib.data(), zlib.size());
+    appendChunk(png, "IEND", nullptr, 0);
+
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef _PNG_WRITER_H_
+#define _PNG_WRITER_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+
+// Runs 'task' for each index in [0, nbTasks), possibly in parallel, and returns once all of
+// them are done
+typedef std::function<void(unsigned int nbTasks, const std::function<void(unsigned int)>& task)> tParallelFor;
+
+
+struct tPNGOptions
+{
+    // 0 (no compression) to 9 (best), 6 gives the same compression than stbi_write_png()
+    unsigned int    level = 6;
+
+    // Only try the 'sub' and 'up' filters on each row, instead of all of them
+    bool            bFastFilters = false;
+};
+
+
+// Encodes RGBA pixels (with tightly packed rows) as a PNG file.
+//
+// The image is split into bands of rows, filtered and compressed independently (by
+// 'parallelFor' if provided), then joined into one zlib stream, like pigz does: each band is a
+// non-final deflate block followed by an empty stored block to realign the stream, and the
+// stream ends with an empty final block and the adler32 of all the bands.
+bool pngEncode(const uint8_t* pPixels, unsigned int width, unsigned int height, const tPNGOptions& options,
+               std::vector<uint8_t>& png, const tParallelFor& parallelFor = tParallelFor());
+
+// Same as pngEncode(), for a paletted image (one index per pixel) whose palette has 'nbColors'
+// (at most 256) RGBA colors. The alpha values are only written if some colors aren't opaque.
+bool pngEncodeIndexed(const uint8_t* pIndices, unsigned int width, unsigned int height, const uint8_t* pPalette,
+                      unsigned int nbColors, const tPNGOptions& options, std::vector<uint8_t>& png,
+                      const tParallelFor& parallelFor = tParallelFor());
+
+#endif
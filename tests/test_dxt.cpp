@@ -0,0 +1,242 @@
+// Checks that the DXT block decoders of every instruction set produce exactly the same pixels as
+// squish, in all the modes of the blocks
+#include "blp.h"
+#include "blp_internal.h"
+#include <squish.h>
+#include <memory.h>
+#include <random>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+
+static const unsigned int NB_BLOCKS = 20000;
+
+// The decoded rows are written with this pitch, to check that nothing is written between them
+static const ptrdiff_t PITCH = 24;
+
+static const uint8_t GUARD = 0xCD;
+
+
+enum tBlockMode
+{
+    MODE_DXT1_4_COLOURS,
+    MODE_DXT1_3_COLOURS,
+    MODE_DXT3,
+    MODE_DXT5_8_ALPHAS,
+    MODE_DXT5_6_ALPHAS,
+};
+
+static const struct
+{
+    tBlockMode  mode;
+    int         flags;
+    const char* strName;
+} MODES[] = {
+    { MODE_DXT1_4_COLOURS,  squish::kDxt1, "DXT1 (4 colours)" },
+    { MODE_DXT1_3_COLOURS,  squish::kDxt1, "DXT1 (3 colours)" },
+    { MODE_DXT3,            squish::kDxt3, "DXT3" },
+    { MODE_DXT5_8_ALPHAS,   squish::kDxt5, "DXT5 (8 alphas)" },
+    { MODE_DXT5_6_ALPHAS,   squish::kDxt5, "DXT5 (6 alphas)" },
+};
+
+static const char* LEVEL_NAMES[] = { "scalar", "SSE2", "AVX2" };
+
+
+// Orders the two 16-bit endpoints at 'pEndpoints' so that the first one is greater ('bGreater')
+// or not greater than the second one
+static void order_endpoints(uint8_t* pEndpoints, bool bGreater)
+{
+    const unsigned int e0 = pEndpoints[0] | (pEndpoints[1] << 8);
+    const unsigned int e1 = pEndpoints[2] | (pEndpoints[3] << 8);
+
+    if ((e0 > e1) != bGreater)
+    {
+        std::swap(pEndpoints[0], pEndpoints[2]);
+        std::swap(pEndpoints[1], pEndpoints[3]);
+    }
+
+    // Equal endpoints can't be greater, change one of them
+    if (bGreater && (e0 == e1))
+        pEndpoints[0] ^= 1;
+}
+
+
+// Random block in the given mode. The equal endpoints are made more frequent than by chance.
+static void random_block(std::mt19937& rng, tBlockMode mode, uint8_t* pBlock)
+{
+    for (unsigned int i = 0; i < 16; ++i)
+        pBlock[i] = uint8_t(rng());
+
+    uint8_t* pColours = ((mode == MODE_DXT1_4_COLOURS) || (mode == MODE_DXT1_3_COLOURS) ? pBlock : pBlock + 8);
+
+    if (rng() % 16 == 0)
+    {
+        pColours[2] = pColours[0];
+        pColours[3] = pColours[1];
+    }
+
+    if ((mode == MODE_DXT5_8_ALPHAS || mode == MODE_DXT5_6_ALPHAS) && (rng() % 16 == 0))
+        pBlock[1] = pBlock[0];
+
+    switch (mode)
+    {
+        case MODE_DXT1_4_COLOURS:   order_endpoints(pColours, true); break;
+        case MODE_DXT1_3_COLOURS:   order_endpoints(pColours, false); break;
+
+        case MODE_DXT5_8_ALPHAS:
+            if (pBlock[0] <= pBlock[1])
+            {
+                std::swap(pBlock[0], pBlock[1]);
+                if (pBlock[0] == pBlock[1])
+                    pBlock[0] ^= 1;
+            }
+            break;
+
+        case MODE_DXT5_6_ALPHAS:
+            if (pBlock[0] > pBlock[1])
+                std::swap(pBlock[0], pBlock[1]);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static void swap_red_blue(uint8_t* pPixels, unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+        std::swap(pPixels[i * 4], pPixels[i * 4 + 2]);
+}
+
+
+static bool test_block_decoders()
+{
+    std::mt19937 rng(1234);
+    bool bSuccess = true;
+
+    for (const auto& mode : MODES)
+    {
+        for (int level = BLP_CPU_SCALAR; level <= blp_cpu_level(); ++level)
+        {
+            const tDXTBlockDecoder decode = blp_dxt_block_decoder(mode.flags, tBLPCpuLevel(level));
+
+            for (int swap = 0; swap < 2; ++swap)
+            {
+                const bool bSwapRB = (swap != 0);
+                unsigned int nbErrors = 0;
+
+                for (unsigned int i = 0; i < NB_BLOCKS; ++i)
+                {
+                    uint8_t block[16];
+                    random_block(rng, mode.mode, block);
+
+                    uint8_t expected[16 * 4];
+                    squish::Decompress(expected, block, mode.flags);
+                    if (bSwapRB)
+                        swap_red_blue(expected, 16);
+
+                    uint8_t decoded[4 * PITCH];
+                    memset(decoded, GUARD, sizeof(decoded));
+                    decode(block, decoded, PITCH, bSwapRB);
+
+                    bool bEqual = true;
+                    for (unsigned int y = 0; y < 4; ++y)
+                    {
+                        bEqual = bEqual && (memcmp(decoded + y * PITCH, expected + y * 16, 16) == 0);
+                        for (unsigned int x = 16; x < PITCH; ++x)
+                            bEqual = bEqual && (decoded[y * PITCH + x] == GUARD);
+                    }
+
+                    if (!bEqual)
+                        ++nbErrors;
+                }
+
+                if (nbErrors > 0)
+                {
+                    printf("%s, %s%s: %u blocks out of %u differ from squish\n", mode.strName, LEVEL_NAMES[level],
+                           (bSwapRB ? ", BGRA" : ""), nbErrors, NB_BLOCKS);
+                    bSuccess = false;
+                }
+            }
+        }
+    }
+
+    return bSuccess;
+}
+
+
+// Image whose dimensions aren't multiples of 4, decoded through blp2_decode_dxt()
+static bool test_image()
+{
+    const unsigned int width = 13;
+    const unsigned int height = 7;
+    const unsigned int nbBlocks = ((width + 3) / 4) * ((height + 3) / 4);
+
+    std::mt19937 rng(5678);
+    bool bSuccess = true;
+
+    for (const auto& mode : MODES)
+    {
+        const unsigned int blockSize = ((mode.flags & squish::kDxt1) != 0 ? 8 : 16);
+
+        std::vector<uint8_t> blocks(nbBlocks * blockSize);
+        for (unsigned int i = 0; i < nbBlocks; ++i)
+        {
+            uint8_t block[16];
+            random_block(rng, mode.mode, block);
+            memcpy(&blocks[i * blockSize], block, blockSize);
+        }
+
+        std::vector<uint8_t> expected(width * height * 4);
+        squish::DecompressImage(expected.data(), width, height, blocks.data(), mode.flags);
+
+        for (tBLPPixelFormat format : { BLP_PIXEL_FORMAT_RGBA8, BLP_PIXEL_FORMAT_BGRA8 })
+        {
+            const ptrdiff_t pitch = width * 4 + 8;
+
+            std::vector<uint8_t> decoded(pitch * height, GUARD);
+
+            tBLPTarget target;
+            target.pData = decoded.data();
+            target.pitch = pitch;
+            target.format = format;
+
+            blp2_decode_dxt(blocks.data(), width, height, mode.flags, target);
+
+            std::vector<uint8_t> reference = expected;
+            if (format == BLP_PIXEL_FORMAT_BGRA8)
+                swap_red_blue(reference.data(), width * height);
+
+            bool bEqual = true;
+            for (unsigned int y = 0; y < height; ++y)
+            {
+                bEqual = bEqual && (memcmp(&decoded[y * pitch], &reference[y * width * 4], width * 4) == 0);
+                for (ptrdiff_t x = width * 4; x < pitch; ++x)
+                    bEqual = bEqual && (decoded[y * pitch + x] == GUARD);
+            }
+
+            if (!bEqual)
+            {
+                printf("%s, %ux%u image%s: differs from squish\n", mode.strName, width, height,
+                       (format == BLP_PIXEL_FORMAT_BGRA8 ? ", BGRA" : ""));
+                bSuccess = false;
+            }
+        }
+    }
+
+    return bSuccess;
+}
+
+
+int main()
+{
+    printf("Instruction set: %s\n", LEVEL_NAMES[blp_cpu_level()]);
+
+    bool bSuccess = test_block_decoders();
+    bSuccess = test_image() && bSuccess;
+
+    printf("%s\n", (bSuccess ? "OK" : "FAILED"));
+    return (bSuccess ? 0 : 1);
+}
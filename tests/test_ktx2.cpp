@@ -0,0 +1,96 @@
+// Checks the data format descriptors written in the KTX2 files against the ones produced by libktx
+// (vk2dfd) for the same Vulkan formats
+#include "ktx2_writer.h"
+#include <stdio.h>
+#include <vector>
+
+
+// Offset of the position and size of the DFD in the header
+static const size_t DFD_INDEX = 48;
+
+
+// VK_FORMAT_BC3_SRGB_BLOCK
+static const uint32_t DFD_BC3_SRGB[] = {
+    60,                                 // Total size
+    0x00000000,                         // Khronos, basic descriptor block
+    0x00380002,                         // Version 1.3, 56 bytes
+    0x00020182,                         // BC3, BT.709 primaries, sRGB transfer, straight alpha
+    0x00000303,                         // 4x4 texels
+    0x00000010,                         // 16 bytes per block
+    0x00000000,
+    0x1F3F0000, 0, 0, 0xFFFFFFFF,       // Alpha (linear), bits 0 to 63
+    0x003F0040, 0, 0, 0xFFFFFFFF,       // Color, bits 64 to 127
+};
+
+// VK_FORMAT_R8G8B8A8_SRGB
+static const uint32_t DFD_RGBA8_SRGB[] = {
+    92,
+    0x00000000,
+    0x00580002,                         // Version 1.3, 88 bytes
+    0x00020101,                         // RGBSDA, BT.709 primaries, sRGB transfer, straight alpha
+    0x00000000,                         // 1x1 texel
+    0x00000004,
+    0x00000000,
+    0x00070000, 0, 0, 255,              // Red
+    0x01070008, 0, 0, 255,              // Green
+    0x02070010, 0, 0, 255,              // Blue
+    0x1F070018, 0, 0, 255,              // Alpha (linear)
+};
+
+
+static uint32_t readUInt32(const std::vector<uint8_t>& data, size_t offset)
+{
+    return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (uint32_t(data[offset + 3]) << 24);
+}
+
+
+static bool check_dfd(tKTX2Format format, const char* strName, const uint32_t* pExpected, size_t nbWords)
+{
+    // One 4x4 level (a single block for the compressed formats)
+    const size_t levelSize = (format == KTX2_FORMAT_RGBA8 ? 4 * 4 * 4 : 16);
+    std::vector<uint8_t> pixels(levelSize, 0x55);
+
+    std::vector<tKTX2Level> levels(1);
+    levels[0].pData = pixels.data();
+    levels[0].size = levelSize;
+
+    std::vector<uint8_t> ktx2;
+    if (!ktx2Encode(format, 4, 4, levels, ktx2))
+    {
+        printf("%s: the file can't be written\n", strName);
+        return false;
+    }
+
+    const uint32_t offset = readUInt32(ktx2, DFD_INDEX);
+    const uint32_t size = readUInt32(ktx2, DFD_INDEX + 4);
+
+    if ((size != nbWords * 4) || (offset + size > ktx2.size()))
+    {
+        printf("%s: DFD of %u bytes instead of %u\n", strName, size, unsigned(nbWords * 4));
+        return false;
+    }
+
+    bool bSuccess = true;
+    for (size_t i = 0; i < nbWords; ++i)
+    {
+        const uint32_t value = readUInt32(ktx2, offset + i * 4);
+        if (value != pExpected[i])
+        {
+            printf("%s: word %u of the DFD is 0x%08X instead of 0x%08X\n", strName, unsigned(i), value,
+                   pExpected[i]);
+            bSuccess = false;
+        }
+    }
+
+    return bSuccess;
+}
+
+
+int main()
+{
+    bool bSuccess = check_dfd(KTX2_FORMAT_BC3, "BC3", DFD_BC3_SRGB, sizeof(DFD_BC3_SRGB) / 4);
+    bSuccess = check_dfd(KTX2_FORMAT_RGBA8, "RGBA8", DFD_RGBA8_SRGB, sizeof(DFD_RGBA8_SRGB) / 4) && bSuccess;
+
+    printf("%s\n", (bSuccess ? "OK" : "FAILED"));
+    return (bSuccess ? 0 : 1);
+}
@@ -0,0 +1,139 @@
+#include "thread_pool.h"
+
+
+// Worker of the pool executing the current thread, if any
+static thread_local tThreadPool* pCurrentPool = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+
+tThreadPool::tThreadPool(unsigned int nbThreads)
+: nextWorker(0), nbQueued(0), nbPending(0), bStop(false)
+{
+    if (nbThreads == 0)
+        nbThreads = std::thread::hardware_concurrency();
+
+    if (nbThreads == 0)
+        nbThreads = 1;
+
+    for (unsigned int i = 0; i < nbThreads; ++i)
+        workers.emplace_back(new tWorker());
+
+    for (unsigned int i = 0; i < nbThreads; ++i)
+        threads.emplace_back(&tThreadPool::run, this, i);
+}
+
+
+tThreadPool::~tThreadPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+    }
+
+    taskAvailable.notify_all();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+
+void tThreadPool::submit(std::function<void()> task)
+{
+    unsigned int index;
+    if (pCurrentPool == this)
+        index = currentWorker;
+    else
+        index = nextWorker.fetch_add(1) % size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++nbQueued;
+        ++nbPending;
+    }
+
+    taskAvailable.notify_one();
+}
+
+
+void tThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return nbPending == 0; });
+}
+
+
+bool tThreadPool::pop(unsigned int index, std::function<void()>& task)
+{
+    tWorker* pWorker = workers[index].get();
+
+    std::lock_guard<std::mutex> lock(pWorker->mutex);
+    if (pWorker->tasks.empty())
+        return false;
+
+    task = std::move(pWorker->tasks.front());
+    pWorker->tasks.pop_front();
+    return true;
+}
+
+
+bool tThreadPool::steal(unsigned int index, std::function<void()>& task)
+{
+    for (unsigned int i = 1; i < size(); ++i)
+    {
+        tWorker* pVictim = workers[(index + i) % size()].get();
+
+        std::lock_guard<std::mutex> lock(pVictim->mutex);
+        if (!pVictim->tasks.empty())
+        {
+            task = std::move(pVictim->tasks.back());
+            pVictim->tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void tThreadPool::run(unsigned int index)
+{
+    pCurrentPool = this;
+    currentWorker = index;
+
+    std::function<void()> task;
+
+    while (true)
+    {
+        // Reserve one of the queued tasks
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return bStop || (nbQueued > 0); });
+
+            if (nbQueued == 0)
+                return;
+
+            --nbQueued;
+        }
+
+        // The reserved task is either in our queue or in the one of another worker
+        while (!pop(index, task) && !steal(index, task))
+            std::this_thread::yield();
+
+        task();
+        task = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --nbPending;
+            if (nbPending == 0)
+                allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A fixed-size pool of worker threads, each one owning a queue of tasks.
+//
+// Tasks submitted from outside the pool are spread over the queues in a
+// round-robin fashion, tasks submitted by a worker go to its own queue. A
+// worker takes the tasks of its queue from the front, and when it runs out of
+// work it steals from the back of the queues of the other workers, so big and
+// small tasks end up balanced between the threads.
+class tThreadPool
+{
+public:
+    // 0 means one thread per CPU core
+    explicit tThreadPool(unsigned int nbThreads = 0);
+    ~tThreadPool();
+
+    tThreadPool(const tThreadPool&) = delete;
+    tThreadPool& operator=(const tThreadPool&) = delete;
+
+    unsigned int size() const { return (unsigned int) workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Blocks until all the submitted tasks are done
+    void wait();
+
+private:
+    struct tWorker
+    {
+        std::mutex                          mutex;
+        std::deque<std::function<void()> >  tasks;
+    };
+
+    bool pop(unsigned int index, std::function<void()>& task);
+    bool steal(unsigned int index, std::function<void()>& task);
+    void run(unsigned int index);
+
+    std::vector<std::unique_ptr<tWorker> >  workers;
+    std::vector<std::thread>                threads;
+
+    std::mutex              mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+
+    std::atomic<unsigned int>   nextWorker;
+    unsigned int                nbQueued;   // Protected by 'mutex'
+    unsigned int                nbPending;  // Protected by 'mutex'
+    bool                        bStop;      // Protected by 'mutex'
+};
+
+#endif